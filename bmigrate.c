@@ -15,9 +15,12 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 #include <assert.h>
+#include <errno.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #ifdef MAC_INTEGRATION
 #include <gtkosxapplication.h>
@@ -25,6 +28,7 @@
 #include <gtk/gtk.h>
 #include <gdk/gdk.h>
 #include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
 #include <gsl/gsl_multifit.h>
 #include <gsl/gsl_histogram.h>
 #include <kplot.h>
@@ -106,6 +110,10 @@ hwin_init(struct hwin *c, GtkBuilder *b)
 	c->mutants[MUTANTS_DISCRETE] = win_init_radio(b, "radiobutton1");
 	c->mutants[MUTANTS_GAUSSIAN] = win_init_radio(b, "radiobutton2");
 	c->weighted = win_init_toggle(b, "checkbutton1");
+	c->engines[ENGINE_SAMPLE] = win_init_toggle(b, "radiobutton17");
+	c->engines[ENGINE_EXACT] = win_init_toggle(b, "radiobutton18");
+	c->engines[ENGINE_DIFFUSION] = win_init_toggle(b, "radiobutton19");
+	c->adaptive = win_init_toggle(b, "checkbutton2");
 	c->menuquit = win_init_menuitem(b, "menuitem5");
 	c->input = win_init_label(b, "label19");
 	c->mutantsigma = win_init_entry(b, "entry17");
@@ -224,6 +232,8 @@ sim_free(gpointer arg)
 				p->threads[i].thread, p);
 			g_thread_join(p->threads[i].thread);
 		}
+	for (i = 0; i < p->nprocs; i++) 
+		simacc_free(&p->threads[i].acc);
 	p->nprocs = 0;
 
 	simbuf_free(p->bufs.means);
@@ -235,11 +245,7 @@ sim_free(gpointer arg)
 	simbuf_free(p->bufs.islandstddevs);
 	simbuf_free(p->bufs.mextinct);
 	simbuf_free(p->bufs.iextinct);
-	kdata_destroy(p->bufs.fractions);
-	kdata_destroy(p->bufs.ifractions);
-	kdata_destroy(p->bufs.mutants);
-	kdata_destroy(p->bufs.incumbents);
-	kdata_destroy(p->bufs.islands);
+	simacc_free(&p->acc);
 	kdata_destroy(p->bufs.meanmins);
 	kdata_destroy(p->bufs.mextinctmaxs);
 	kdata_destroy(p->bufs.iextinctmins);
@@ -250,15 +256,21 @@ sim_free(gpointer arg)
 	kdata_destroy(p->bufs.fitminqbuf);
 
 	hnode_free(p->exp);
+	hprog_free(p->prog);
+	for (i = 0; i < p->progsz; i++)
+		hprog_free(p->progs[i]);
+	g_free(p->progs);
+	if (NULL != p->ptabs)
+		for (i = 0; i < p->dims * p->dims; i++)
+			g_free(p->ptabs[i]);
+	g_free(p->ptabs);
 	g_mutex_clear(&p->hot.mux);
 	g_cond_clear(&p->hot.cond);
 	g_free(p->name);
 	g_free(p->func);
-	if (NULL != p->ms)
-		for (i = 0; i < p->islands; i++)
-			g_free(p->ms[i]);
-	g_free(p->ms);
+	mkernel_free(p->ms);
 	g_free(p->pops);
+	g_free(p->sched);
 	kml_free(p->kml);
 	if (p->fitpoly) {
 		g_free(p->work.coeffs);
@@ -315,7 +327,9 @@ bmigrate_free(struct bmigrate *p)
 	g_list_free_full(p->sims, sim_free);
 	p->sims = NULL;
 	hnode_free(p->range.exp);
+	hprog_free(p->range.prog);
 	p->range.exp = NULL;
+	p->range.prog = NULL;
 	if (NULL != p->status_elapsed)
 		g_timer_destroy(p->status_elapsed);
 	p->status_elapsed = NULL;
@@ -347,6 +361,29 @@ on_sim_pause(struct sim *sim, int dopause)
 		g_debug("Pausing simulation %p", sim);
 }
 
+/*
+ * Merge each thread's raw results into the simulation's, then have the
+ * simulation copy out when it gets a chance.
+ * This must only be called when no copyout is under way, as the
+ * simulation's merged results are then ours alone.
+ */
+static void
+sim_copyout(struct sim *sim)
+{
+	size_t	 i;
+
+	for (i = 0; i < sim->nprocs; i++) {
+		g_mutex_lock(&sim->threads[i].acc.mux);
+		simacc_merge(&sim->acc, &sim->threads[i].acc);
+		g_mutex_unlock(&sim->threads[i].acc.mux);
+	}
+
+	g_mutex_lock(&sim->hot.mux);
+	g_assert(0 == sim->hot.copyout);
+	sim->hot.copyout = 1;
+	g_mutex_unlock(&sim->hot.mux);
+}
+
 static void
 cqueue_fill(size_t pos, struct kpair *kp, void *arg)
 {
@@ -409,10 +446,7 @@ on_sim_copyout(gpointer dat)
 		 */
 		if (sim->cold.truns == sim->warm.truns) {
 			assert(sim->cold.tgens == sim->warm.tgens);
-			g_mutex_lock(&sim->hot.mux);
-			g_assert(0 == sim->hot.copyout);
-			sim->hot.copyout = 1;
-			g_mutex_unlock(&sim->hot.mux);
+			sim_copyout(sim);
 			continue;
 		}
 
@@ -471,10 +505,7 @@ on_sim_copyout(gpointer dat)
 			&sim->bufs.fitminq, cqueue_fill);
 
 		/* Copy-out when convenient. */
-		g_mutex_lock(&sim->hot.mux);
-		g_assert(0 == sim->hot.copyout);
-		sim->hot.copyout = 1;
-		g_mutex_unlock(&sim->hot.mux);
+		sim_copyout(sim);
 	}
 
 	return(TRUE);
@@ -1228,11 +1259,40 @@ main(int argc, char *argv[])
 {
 	GtkBuilder	*builder;
 	struct bmigrate	 b;
-	int		 rc;
+	int		 rc, c;
+	gchar		*ep;
 
 	memset(&b, 0, sizeof(struct bmigrate));
 	gtk_init(&argc, &argv);
 
+	/*
+	 * With -n, try to compile payoff functions into native code.
+	 * With -s, use the given seed for all simulations.
+	 * Stop quietly at what we don't know: the launcher may pass its
+	 * own (e.g., -psn_ on Mac OS X).
+	 */
+	opterr = 0;
+	while (-1 != (c = getopt(argc, argv, "ns:")))
+		switch (c) {
+		case ('n'):
+			b.native = 1;
+			break;
+		case ('s'):
+			/* No signs or spaces: only a whole number. */
+			errno = 0;
+			b.seed = g_ascii_strtoull(optarg, &ep, 0);
+			if ( ! g_ascii_isdigit(*optarg) || 
+			     '\0' != *ep || ERANGE == errno) {
+				fprintf(stderr, "%s: bad seed\n", optarg);
+				return(EXIT_FAILURE);
+			}
+			b.seeded = 1;
+			break;
+		default:
+			goto args;
+		}
+args:
+
 	rc = kplotcfg_default_palette(&b.clrs, &b.clrsz);
 	g_assert(0 != rc);
 
@@ -18,9 +18,11 @@
 #include <math.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <gtk/gtk.h>
 #include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
 #include <gsl/gsl_multifit.h>
 #include <gsl/gsl_histogram.h>
 #include <kplot.h>
@@ -39,15 +41,18 @@ simbuf_alloc_warm(struct kdata *hot, size_t bufsz)
 	return(buf);
 }
 
+/*
+ * Allocate a buffer whose "hotlsb" array is filled in directly by the
+ * thread copying out (see on_sim_stats()), then copied into "warm" and
+ * "cold" storage.
+ */
 struct simbuf *
-simbuf_alloc(struct kdata *hot, size_t bufsz)
+simbuf_alloc(size_t bufsz)
 {
 	struct simbuf	*buf;
 
-	g_assert(NULL != hot);
 	buf = g_malloc0(sizeof(struct simbuf));
-	buf->hot = hot;
-	buf->hotlsb = kdata_buffer_alloc(bufsz);
+	buf->hotlsb = kdata_array_alloc(NULL, bufsz);
 	g_assert(NULL != buf->hotlsb);
 	buf->warm = kdata_buffer_alloc(bufsz);
 	g_assert(NULL != buf->warm);
@@ -60,7 +65,6 @@ void
 simbuf_free(struct simbuf *buf)
 {
 
-	kdata_destroy(buf->hot);
 	kdata_destroy(buf->hotlsb);
 	kdata_destroy(buf->warm);
 	kdata_destroy(buf->cold);
@@ -68,28 +72,126 @@ simbuf_free(struct simbuf *buf)
 }
 
 void
-simbuf_copy_hotlsb(struct simbuf *buf)
+simbuf_copy_warm(struct simbuf *buf)
 {
 	int	rc;
 
-	rc = kdata_buffer_copy(buf->hotlsb, buf->hot);
+	rc = kdata_buffer_copy(buf->warm, buf->hotlsb);
 	g_assert(0 != rc);
 }
 
 void
-simbuf_copy_warm(struct simbuf *buf)
+simbuf_copy_cold(struct simbuf *buf)
 {
 	int	rc;
 
-	rc = kdata_buffer_copy(buf->warm, buf->hotlsb);
+	rc = kdata_buffer_copy(buf->cold, buf->warm);
 	g_assert(0 != rc);
 }
 
 void
-simbuf_copy_cold(struct simbuf *buf)
+simacc_init(struct simacc *acc, size_t dims, size_t islands, size_t stop)
 {
-	int	rc;
 
-	rc = kdata_buffer_copy(buf->cold, buf->warm);
-	g_assert(0 != rc);
+	memset(acc, 0, sizeof(struct simacc));
+	g_mutex_init(&acc->mux);
+	acc->dims = dims;
+	acc->islands = islands;
+	acc->stop = stop;
+	acc->times = g_malloc0_n(stop + 1, sizeof(double));
+	acc->fracs = g_malloc0_n(dims, sizeof(struct simstat));
+	acc->mextinct = g_malloc0_n(dims, sizeof(double));
+	acc->iextinct = g_malloc0_n(dims, sizeof(double));
+	acc->ifracs = g_malloc0_n(islands, sizeof(struct simstat));
+	acc->occupied = g_malloc0_n(islands, sizeof(struct simstat));
+}
+
+void
+simacc_free(struct simacc *acc)
+{
+
+	g_mutex_clear(&acc->mux);
+	g_free(acc->times);
+	g_free(acc->fracs);
+	g_free(acc->mextinct);
+	g_free(acc->iextinct);
+	g_free(acc->ifracs);
+	g_free(acc->occupied);
+}
+
+/*
+ * Add the sample "x" with Welford's method.
+ */
+void
+simstat_add(struct simstat *p, double x)
+{
+	double	 d;
+
+	p->n++;
+	d = x - p->mean;
+	p->mean += d / p->n;
+	p->m2 += d * (x - p->mean);
+}
+
+/*
+ * Add the samples of "from" with the pairwise update of Chan et al.
+ */
+void
+simstat_merge(struct simstat *into, const struct simstat *from)
+{
+	double	 n, d;
+
+	if (0.0 == from->n)
+		return;
+	n = into->n + from->n;
+	d = from->mean - into->mean;
+	into->mean += d * from->n / n;
+	into->m2 += from->m2 + d * d * into->n * from->n / n;
+	into->n = n;
+}
+
+static void
+simacc_drain(double *to, double *from, size_t sz)
+{
+	size_t	 i;
+
+	for (i = 0; i < sz; i++)
+		to[i] += from[i];
+	memset(from, 0, sz * sizeof(double));
+}
+
+static void
+simacc_drainstat(struct simstat *to, struct simstat *from, size_t sz)
+{
+	size_t	 i;
+
+	for (i = 0; i < sz; i++)
+		simstat_merge(&to[i], &from[i]);
+	memset(from, 0, sz * sizeof(struct simstat));
+}
+
+/*
+ * Add the statistics of "from" into "into", then zero "from".
+ * The caller must hold the lock of "from".
+ */
+void
+simacc_merge(struct simacc *into, struct simacc *from)
+{
+
+	g_assert(into->dims == from->dims);
+	g_assert(into->islands == from->islands);
+	g_assert(into->stop == from->stop);
+
+	into->truns += from->truns;
+	into->tgens += from->tgens;
+	into->fixed += from->fixed;
+	from->truns = from->tgens = from->fixed = 0;
+
+	simacc_drain(into->times, from->times, from->stop + 1);
+	simacc_drainstat(into->fracs, from->fracs, from->dims);
+	simacc_drain(into->mextinct, from->mextinct, from->dims);
+	simacc_drain(into->iextinct, from->iextinct, from->dims);
+	simacc_drainstat(into->ifracs, from->ifracs, from->islands);
+	simacc_drainstat(into->occupied, 
+		from->occupied, from->islands);
 }
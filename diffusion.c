@@ -0,0 +1,217 @@
+/*	$Id$ */
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtk/gtk.h>
+#include <gsl/gsl_multifit.h>
+#include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
+#include <kplot.h>
+
+#include "extern.h"
+
+/*
+ * The diffusion engine approximates the global mutant fraction "y" by a
+ * diffusion, assuming migration keeps islands at the same fraction (the
+ * strong-migration limit).
+ * Then each of the "N" islands of "n" islanders independently gains a
+ * mutant with probability proportional to a(1 - y), and loses one with
+ * b y, where "a" and "b" are the mutants' and incumbents' births (see
+ * hist_run() in simulation.c), giving the drift "M" and variance "V" of
+ * "y" over a generation.
+ * The fixation probability from "y" solves the backward equation
+ * M u' + V u'' / 2 = 0, so u(y) = S(y) / S(1) with the scale function
+ * S(y), the integral of exp(L), where L' = -2M / V.
+ * The mean absorption time t(y) solves M t' + V t'' / 2 = -1 and is the
+ * integral of the Green's function.
+ * We integrate numerically on a grid from 1 / Nn to 1 - 1 / Nn, evenly
+ * spaced in logit(y) so that it's fine near both ends, working with
+ * logarithms as "L" is proportional to the total population.
+ */
+
+/*
+ * Grid points.
+ */
+#define	DIFFUSION_GRID	 4096
+
+struct	diffusion {
+	size_t		 len; /* grid points */
+	double		*ys; /* grid */
+	double		*xs; /* batch strategies */
+	double		*Xs; /* batch island strategy sums */
+	size_t		*ns; /* batch island sizes */
+	double		*vs; /* batch payoffs */
+	double		*L; /* log scale density */
+	double		*logv; /* log variance */
+};
+
+/*
+ * log(exp(a) + exp(b)) without overflow.
+ */
+static double
+logadd(double a, double b)
+{
+
+	if (a < b)
+		return(b + log1p(exp(a - b)));
+	return(a + log1p(exp(b - a)));
+}
+
+struct diffusion *
+diffusion_alloc(const struct sim *sim)
+{
+	struct diffusion *p;
+	double		  x0, z;
+	size_t		  i;
+
+	g_assert(NULL == sim->pops && sim->pop > 0);
+
+	p = g_malloc0(sizeof(struct diffusion));
+	p->len = DIFFUSION_GRID;
+	p->ys = g_malloc_n(p->len, sizeof(double));
+	p->xs = g_malloc_n(2 * p->len, sizeof(double));
+	p->Xs = g_malloc_n(2 * p->len, sizeof(double));
+	p->ns = g_malloc_n(2 * p->len, sizeof(size_t));
+	p->vs = g_malloc_n(2 * p->len, sizeof(double));
+	p->L = g_malloc_n(p->len, sizeof(double));
+	p->logv = g_malloc_n(p->len, sizeof(double));
+
+	x0 = 1.0 / sim->totalpop;
+	z = log((1.0 - x0) / x0);
+	for (i = 0; i < p->len; i++)
+		p->ys[i] = 1.0 / (1.0 + exp(z -
+			2.0 * z * i / (double)(p->len - 1)));
+	p->ys[0] = x0;
+	p->ys[p->len - 1] = 1.0 - x0;
+
+	for (i = 0; i < 2 * p->len; i++)
+		p->ns[i] = sim->pop;
+	return(p);
+}
+
+void
+diffusion_free(struct diffusion *p)
+{
+
+	if (NULL == p)
+		return;
+	g_free(p->ys);
+	g_free(p->xs);
+	g_free(p->Xs);
+	g_free(p->ns);
+	g_free(p->vs);
+	g_free(p->L);
+	g_free(p->logv);
+	g_free(p);
+}
+
+/*
+ * Solve for the fixation probability of a single mutant, also filling
+ * in the mean number of generations until either type dies out.
+ */
+double
+diffusion_solve(struct diffusion *p, const struct sim *sim,
+	double mutant, double incumbent, double *time)
+{
+	size_t		 i, G = p->len;
+	double		 n = sim->pop, N = sim->islands, x0 = p->ys[0],
+			 y, k, lm, li, a, b, f, fprev, logs, logs0, logu,
+			 logr, h, d, t, g, gprev;
+
+	/* Payoffs of both types at each grid point in one batch. */
+	for (i = 0; i < G; i++) {
+		k = p->ys[i] * n;
+		p->xs[i] = mutant;
+		p->xs[G + i] = incumbent;
+		p->Xs[i] = p->Xs[G + i] =
+			k * mutant + (n - k) * incumbent;
+	}
+	hprog_exec_batch(sim->prog, p->xs, p->Xs, p->ns, p->vs, 2 * G);
+
+	/*
+	 * Per generation, the drift is the expected gains less losses
+	 * over all islands, and the variance their sum, in units of the
+	 * total population.
+	 * Their ratio, 2M / V, simplifies to 2Nn(lm - li) / (lm + li).
+	 * Like poisson() in simulation.c, we take a fitness below zero
+	 * as no births.
+	 * If neither type has births, nothing moves: there's no drift,
+	 * and no variance, so the mean time is infinite.
+	 */
+	fprev = 0.0;
+	for (i = 0; i < G; i++) {
+		y = p->ys[i];
+		lm = sim->alpha * (1.0 + sim->delta * p->vs[i]);
+		li = sim->alpha * (1.0 + sim->delta * p->vs[G + i]);
+		lm = lm > 0.0 ? lm : 0.0;
+		li = li > 0.0 ? li : 0.0;
+		if (lm + li > 0.0) {
+			a = lm * y * n;
+			b = li * (1.0 - y) * n;
+			p->logv[i] = log(-expm1(-(a + b))) + 
+				log(y) + log1p(-y) + log(lm + li) -
+				log(lm * y + li * (1.0 - y)) -
+				log(N) - 2.0 * log(n);
+			f = 2.0 * N * n * (lm - li) / (lm + li);
+		} else {
+			p->logv[i] = -INFINITY;
+			f = 0.0;
+		}
+		if (0 == i)
+			p->L[i] = -f * x0;
+		else
+			p->L[i] = p->L[i - 1] - 0.5 *
+				(f + fprev) * (p->ys[i] - p->ys[i - 1]);
+		fprev = f;
+	}
+
+	/* Scale function from zero to the first point and to one. */
+	logs0 = log(x0) + logadd(0.0, p->L[0]) - M_LN2;
+	for (logs = logs0, i = 1; i < G; i++) {
+		h = p->ys[i] - p->ys[i - 1];
+		logs = logadd(logs, log(h) - M_LN2 +
+			logadd(p->L[i - 1], p->L[i]));
+	}
+	logs = logadd(logs, log(x0) + p->L[G - 1]);
+	logu = logs0 - logs;
+
+	/*
+	 * Mean time: the Green's function above the starting point is
+	 * 2u(S(1) - S(y)) / (V(y) exp(L(y))), where we carry R(y) =
+	 * (S(1) - S(y)) / exp(L(y)) down from the top; below, it's
+	 * about 2(1 - u)y / V(y).
+	 */
+	logr = log(x0);
+	gprev = 2.0 * exp(logu + logr - p->logv[G - 1]);
+	t = x0 * gprev;
+	for (i = G - 1; i > 0; i--) {
+		h = p->ys[i] - p->ys[i - 1];
+		d = p->L[i] - p->L[i - 1];
+		logr = logadd(log(h) - M_LN2 + logadd(0.0, d),
+			d + logr);
+		g = 2.0 * exp(logu + logr - p->logv[i - 1]);
+		t += 0.5 * h * (g + gprev);
+		gprev = g;
+	}
+	t += 2.0 * -expm1(logu) * x0 * x0 / exp(p->logv[0]);
+
+	*time = t;
+	return(exp(logu));
+}
@@ -23,6 +23,7 @@
 #include <cairo.h>
 #include <gtk/gtk.h>
 #include <gsl/gsl_multifit.h>
+#include <gsl/gsl_randist.h>
 #include <kplot.h>
 
 #include "extern.h"
@@ -0,0 +1,326 @@
+/*	$Id$ */
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtk/gtk.h>
+#include <gsl/gsl_multifit.h>
+#include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
+#include <gsl/gsl_spmatrix.h>
+#include <gsl/gsl_splinalg.h>
+#include <kplot.h>
+
+#include "extern.h"
+
+/*
+ * The exact engine solves the Markov chain of simulation() over all
+ * vectors of island mutant counts.
+ * Given the state, the arrivals at each island from each type are
+ * independent Poisson variates, so each island independently gains a
+ * mutant, loses one, or stays put (see hist_run() in simulation.c), and
+ * a transition's probability is the product over islands.
+ * The fixation probabilities "h" and mean absorption times "t" from
+ * each transient state solve (I - Q)h = r and (I - Q)t = 1, where "Q"
+ * is the chain restricted to transient states and "r" the probability
+ * of fixating in one step.
+ * Island death isn't modelled.
+ */
+
+/*
+ * Bound on the transitions of the chain, i.e., states times three to
+ * the number of islands.
+ * Each thread has its own matrix, so this bounds memory.
+ */
+#define	EXACT_MAX	 (1024 * 1024)
+
+/*
+ * Relative residual we solve to and the most GMRES restarts we make.
+ */
+#define	EXACT_TOL	 1e-10
+#define	EXACT_ITERS	 1000
+
+/*
+ * Dimension of the GMRES Krylov subspace.
+ */
+#define	EXACT_KRYLOV	 30
+
+struct	exact {
+	size_t		  islands;
+	const size_t	 *pops; /* island sizes or NULL */
+	size_t		  pop; /* uniform island size */
+	size_t		 *strides; /* state index of one mutant */
+	size_t		  states; /* all states */
+	size_t		  len; /* transient states */
+	size_t		 *ks; /* mutants on each island */
+	int		 *moves; /* move of each island */
+	double		 *mm; /* mutant births on each island */
+	double		 *mi; /* incumbent births on each island */
+	double		 *inm; /* kernel: mutant arrivals */
+	double		 *ini; /* kernel: incumbent arrivals */
+	double		(*probs)[3]; /* stay, lose, or gain */
+	gsl_spmatrix	 *A; /* I - Q (triplet) */
+	gsl_vector	 *r; /* one-step fixation */
+	gsl_vector	 *ones;
+	gsl_vector	 *fix; /* fixation probabilities */
+	gsl_vector	 *time; /* mean absorption times */
+	gsl_splinalg_itersolve *work;
+};
+
+/*
+ * Whether the chain for the given islands is small enough to solve.
+ */
+int
+exact_feasible(size_t islands, size_t pop, const size_t *pops)
+{
+	size_t	 i, n;
+
+	for (n = 1, i = 0; i < islands; i++) {
+		n *= 3 * ((NULL != pops ? pops[i] : pop) + 1);
+		if (n > EXACT_MAX)
+			return(0);
+	}
+	return(1);
+}
+
+struct exact *
+exact_alloc(const struct sim *sim)
+{
+	struct exact	*p;
+	size_t		 i;
+
+	g_assert(exact_feasible(sim->islands, sim->pop, sim->pops));
+	g_assert( ! (NULL != sim->pops && sim->ideathmean > 0));
+
+	p = g_malloc0(sizeof(struct exact));
+	p->islands = sim->islands;
+	p->pops = sim->pops;
+	p->pop = sim->pop;
+	p->strides = g_malloc0_n(sim->islands, sizeof(size_t));
+	for (p->states = 1, i = 0; i < sim->islands; i++) {
+		p->strides[i] = p->states;
+		p->states *= (NULL != sim->pops ?
+			sim->pops[i] : sim->pop) + 1;
+	}
+	g_assert(p->states > 2);
+	p->len = p->states - 2;
+
+	p->ks = g_malloc0_n(sim->islands, sizeof(size_t));
+	p->moves = g_malloc0_n(sim->islands, sizeof(int));
+	p->mm = g_malloc0_n(sim->islands, sizeof(double));
+	p->mi = g_malloc0_n(sim->islands, sizeof(double));
+	p->inm = g_malloc0_n(sim->islands, sizeof(double));
+	p->ini = g_malloc0_n(sim->islands, sizeof(double));
+	p->probs = g_malloc0_n(sim->islands, sizeof(double[3]));
+	p->A = gsl_spmatrix_alloc_nzmax(p->len, p->len,
+		4 * p->len, GSL_SPMATRIX_TRIPLET);
+	p->r = gsl_vector_alloc(p->len);
+	p->ones = gsl_vector_alloc(p->len);
+	p->fix = gsl_vector_alloc(p->len);
+	p->time = gsl_vector_alloc(p->len);
+	for (i = 0; i < p->len; i++)
+		gsl_vector_set(p->ones, i, 1.0);
+	p->work = gsl_splinalg_itersolve_alloc
+		(gsl_splinalg_itersolve_gmres,
+		 p->len, MIN(p->len, EXACT_KRYLOV));
+	return(p);
+}
+
+void
+exact_free(struct exact *p)
+{
+
+	if (NULL == p)
+		return;
+	g_free(p->strides);
+	g_free(p->ks);
+	g_free(p->moves);
+	g_free(p->mm);
+	g_free(p->mi);
+	g_free(p->inm);
+	g_free(p->ini);
+	g_free(p->probs);
+	gsl_spmatrix_free(p->A);
+	gsl_vector_free(p->r);
+	gsl_vector_free(p->ones);
+	gsl_vector_free(p->fix);
+	gsl_vector_free(p->time);
+	gsl_splinalg_itersolve_free(p->work);
+	g_free(p);
+}
+
+/*
+ * Fill in each island's move probabilities from state "s".
+ */
+static void
+exact_probs(struct exact *p, const struct sim *sim,
+	const struct payoff *const *rows, size_t s)
+{
+	size_t		 j, n, k;
+	double		 tm, ti, a, b, pany;
+
+	tm = ti = 0.0;
+	for (j = 0; j < p->islands; j++) {
+		n = NULL != p->pops ? p->pops[j] : p->pop;
+		k = p->ks[j] = (s / p->strides[j]) % (n + 1);
+		p->mm[j] = rows[j][k].m * k;
+		p->mi[j] = rows[j][k].i * (n - k);
+		tm += p->mm[j];
+		ti += p->mi[j];
+	}
+
+	if (NULL != sim->ms) {
+		memset(p->inm, 0, p->islands * sizeof(double));
+		memset(p->ini, 0, p->islands * sizeof(double));
+		for (j = 0; j < p->islands; j++) {
+			mkernel_spread(sim->ms, j,
+				sim->m * p->mm[j], p->inm);
+			mkernel_spread(sim->ms, j,
+				sim->m * p->mi[j], p->ini);
+		}
+	} else if (p->islands > 1)
+		for (j = 0; j < p->islands; j++) {
+			p->inm[j] = sim->m * (tm - p->mm[j]) /
+				(p->islands - 1);
+			p->ini[j] = sim->m * (ti - p->mi[j]) /
+				(p->islands - 1);
+		}
+
+	for (j = 0; j < p->islands; j++) {
+		n = NULL != p->pops ? p->pops[j] : p->pop;
+		k = p->ks[j];
+		a = (1.0 - sim->m) * p->mm[j] + p->inm[j];
+		b = (1.0 - sim->m) * p->mi[j] + p->ini[j];
+		p->probs[j][1] = p->probs[j][2] = 0.0;
+		if (a + b > 0.0) {
+			pany = -expm1(-(a + b));
+			p->probs[j][1] = pany * b / (a + b) * k / n;
+			p->probs[j][2] = pany * a / (a + b) * (n - k) / n;
+		}
+		p->probs[j][0] = 1.0 - p->probs[j][1] - p->probs[j][2];
+	}
+}
+
+/*
+ * Solve "x" from "b" with the matrix "C".
+ * Returns zero if we didn't converge, leaving our best guess.
+ */
+static int
+exact_gmres(struct exact *p, const gsl_spmatrix *C,
+	const gsl_vector *b, gsl_vector *x)
+{
+	size_t	 iter;
+	int	 rc;
+
+	gsl_vector_set_zero(x);
+	iter = 0;
+	do
+		rc = gsl_splinalg_itersolve_iterate
+			(C, b, EXACT_TOL, x, p->work);
+	while (GSL_CONTINUE == rc && ++iter < EXACT_ITERS);
+
+	if (GSL_SUCCESS == rc)
+		return(1);
+	g_debug("%p: Exact solve stopped with residual %g",
+		g_thread_self(), gsl_splinalg_itersolve_normr(p->work));
+	return(0);
+}
+
+/*
+ * Build and solve the chain, where "rows" points to the payoffs with no
+ * mutants on each island, followed by those for one mutant, two, etc.
+ * Returns zero if either solve didn't converge.
+ */
+int
+exact_solve(struct exact *p, const struct sim *sim,
+	const struct payoff *const *rows)
+{
+	gsl_spmatrix	*C;
+	size_t		 s, t, j, r;
+	double		 pr, self;
+	int		 rc;
+
+	gsl_spmatrix_set_zero(p->A);
+	gsl_vector_set_zero(p->r);
+
+	for (r = 0; r < p->len; r++) {
+		s = r + 1;
+		exact_probs(p, sim, rows, s);
+		self = 0.0;
+
+		/* Run through each island's moves, odometer-style. */
+		memset(p->moves, 0, p->islands * sizeof(int));
+		for (;;) {
+			pr = 1.0;
+			t = s;
+			for (j = 0; j < p->islands; j++) {
+				pr *= p->probs[j][p->moves[j]];
+				if (1 == p->moves[j])
+					t -= p->strides[j];
+				else if (2 == p->moves[j])
+					t += p->strides[j];
+			}
+			if (pr <= 0.0)
+				;
+			else if (t == s)
+				self = pr;
+			else if (p->states - 1 == t)
+				gsl_vector_set(p->r, r, pr);
+			else if (0 != t)
+				gsl_spmatrix_set(p->A, r, t - 1, -pr);
+
+			for (j = 0; j < p->islands; j++) {
+				while (++p->moves[j] < 3 &&
+				       0.0 == p->probs[j][p->moves[j]])
+					/* Skip impossible moves. */ ;
+				if (p->moves[j] < 3)
+					break;
+				p->moves[j] = 0;
+			}
+			if (j == p->islands)
+				break;
+		}
+
+		gsl_spmatrix_set(p->A, r, r, 1.0 - self);
+	}
+
+	C = gsl_spmatrix_compress(p->A, GSL_SPMATRIX_CSC);
+	rc = exact_gmres(p, C, p->r, p->fix);
+	rc = exact_gmres(p, C, p->ones, p->time) && rc;
+	gsl_spmatrix_free(C);
+	return(rc);
+}
+
+/*
+ * Fixation probability and mean absorption time having started with a
+ * single mutant on the given island.
+ */
+double
+exact_fixation(const struct exact *p, size_t island)
+{
+
+	return(gsl_vector_get(p->fix, p->strides[island] - 1));
+}
+
+double
+exact_time(const struct exact *p, size_t island)
+{
+
+	return(gsl_vector_get(p->time, p->strides[island] - 1));
+}
@@ -24,6 +24,13 @@
  */
 #define STACKSZ 128
 
+/*
+ * Maximum number of nodes in an expression.
+ * This is only to keep register numbers small (see HREG__MAX): nobody
+ * will type this much into an entry.
+ */
+#define	EXPRSZ	16384
+
 enum 	htype {
 	HNODE_P1, /* player strategy */
 	HNODE_PN, /* sum of players' strategies */
@@ -49,6 +56,77 @@ struct 	hnode {
 	double		  real; /* HNODE_NUMBER, if applicable */
 };
 
+/*
+ * Operations of a compiled expression.
+ * Registers are indexed by "dst", "a", "b", and "c"; immediates are
+ * in "k".
+ * Those marked "K" take "k" as their second operand, "R" reverses the
+ * operand order.
+ */
+enum	hop {
+	HOP_LOADK, /* dst = k */
+	HOP_ADD, /* dst = a + b */
+	HOP_SUB, /* dst = a - b */
+	HOP_MUL, /* dst = a * b */
+	HOP_DIV, /* dst = a / b */
+	HOP_POW, /* dst = pow(a, b) */
+	HOP_SQRT, /* dst = sqrt(a) */
+	HOP_EXPF, /* dst = exp(a) */
+	HOP_NEG, /* dst = -a */
+	HOP_ADDK, /* dst = a + k */
+	HOP_SUBK, /* dst = a - k */
+	HOP_RSUBK, /* dst = k - a */
+	HOP_MULK, /* dst = a * k */
+	HOP_DIVK, /* dst = a / k */
+	HOP_RDIVK, /* dst = k / a */
+	HOP_POWK, /* dst = pow(a, k) */
+	HOP_SQ, /* dst = a * a */
+	HOP_MADD, /* dst = a * b + c */
+	HOP_MSUB, /* dst = a * b - c */
+	HOP_NMADD, /* dst = c - a * b */
+	HOP__MAX
+};
+
+/*
+ * Registers of a compiled expression.
+ * The first three are the inputs; the rest are temporaries, each
+ * written once.
+ * Expressions have at most EXPRSZ nodes, plus STACKSZ more from
+ * expanding powers, each of which needs at most two instructions
+ * (loading a constant and operating on it), plus the result may need
+ * loading.
+ * Most need far fewer: programs of up to HREGSZ registers are run from
+ * a register file on the stack.
+ */
+#define	HREG_P1		 0
+#define	HREG_PN		 1
+#define	HREG_N		 2
+#define	HREG__MAX	 (4 + 2 * (EXPRSZ + STACKSZ))
+#define	HREGSZ		 (4 + 2 * STACKSZ)
+
+struct	hins {
+	enum hop	  op;
+	unsigned short	  dst;
+	unsigned short	  a;
+	unsigned short	  b;
+	unsigned short	  c;
+	double		  k;
+};
+
+/*
+ * An expression compiled from its postfix "struct hnode" list into a
+ * flat array of register instructions.
+ */
+struct	hprog {
+	struct hins	 *ins; /* instructions */
+	size_t		  len; /* number of instructions */
+	unsigned short	  res; /* register holding result */
+	unsigned short	  regs; /* registers used */
+	double		(*fn)(double, double, double); /* native */
+	void		 *dl; /* shared object of "fn" */
+	GThread		 *cc; /* native compilation of "fn" */
+};
+
 struct	cqueue {
 	size_t		 pos; /* current queue position */
 #define	CQUEUESZ	 256
@@ -57,19 +135,12 @@ struct	cqueue {
 };
 
 struct	simbuf {
-	struct kdata	*hot;
 	struct kdata	*hotlsb;
 	struct kdata	*warm;
 	struct kdata	*cold;
 };
 
 struct	simbufs {
-	/* Mutant fraction per incumbent. */
-	struct kdata	*fractions;
-	/* Mutant extinction per incumbent. */
-	struct kdata	*mutants;
-	/* Incumbent extinction per incumbent. */
-	struct kdata	*incumbents;
 	/* PMF of "fractions" minimum. */
 	struct kdata	*meanmins;
 	/* PMF of "mutants" maximum. */
@@ -86,10 +157,6 @@ struct	simbufs {
 	struct kdata	*meanminqbuf;
 	/* Serialisation of "fitminq". */
 	struct kdata	*fitminqbuf;
-	/* Mutant fraction when starting on an island. */
-	struct kdata	*ifractions;
-	/* Mutant fraction per island (all incumbents). */
-	struct kdata	*islands;
 
 	struct simbuf	*times;
 	struct simbuf	*imeans;
@@ -107,21 +174,18 @@ struct	simbufs {
 /*
  * This structure is maintained by a thread group for a particular
  * running simulation.
- * All reads/writes must lock the mutex before modifications.
+ * All reads/writes must lock the mutex before modifications, save for
+ * "ticket", which is only ever atomically incremented.
  * This data is periodically snapshotted to "struct simwarm", which is
  * triggered by the first thread encountering copyout == 1.
  */
 struct	simhot {
 	GMutex		 mux; /* lock for changing data */
 	GCond		 cond; /* mutex for waiting on snapshot */
-	uint64_t	 truns; /* total number of runs */
-	uint64_t	 tgens; /* total number of generations */
 	int		 copyout; /* do we need to snapshot? */
 	int		 pause; /* should we pause? */
 	size_t		 copyblock; /* threads blocking on copy */
-	size_t		 incumbent; /* current incumbent index */
-	size_t		 mutant; /* current mutant index */
-	size_t		 island; /* current island index */
+	uint64_t	 ticket; /* next lattice point (atomic) */
 };
 
 /*
@@ -135,6 +199,40 @@ struct	simwarm {
 	uint64_t	 tgens; /* total number of generations */
 };
 
+/*
+ * Running statistics of a series of samples: their count, mean, and sum
+ * of squared differences from the mean.
+ * These are updated with Welford's method and merged with the pairwise
+ * method of Chan et al., as sums of squares lose too much precision.
+ */
+struct	simstat {
+	double		 n;
+	double		 mean;
+	double		 m2;
+};
+
+/*
+ * Raw statistics of finished runs.
+ * Each simulation thread keeps its own, locking "mux" only to keep the
+ * main thread from merging them mid-update, and these are merged into
+ * the simulation's own at each copyout.
+ */
+struct	simacc {
+	GMutex		 mux; /* lock for merging */
+	size_t		 dims; /* incumbents sampled */
+	size_t		 islands; /* number of islands */
+	size_t		 stop; /* maximum generations */
+	uint64_t	 truns; /* total number of runs */
+	uint64_t	 tgens; /* total number of generations */
+	double		*times; /* runs per generations run */
+	struct simstat	*fracs; /* mutant fraction per incumbent */
+	double		*mextinct; /* mutant extinctions per incumbent */
+	double		*iextinct; /* incumbent extinctions per incumbent */
+	struct simstat	*ifracs; /* mutant fraction per start island */
+	struct simstat	*occupied; /* mutants per island, if any */
+	uint64_t	 fixed; /* runs fixating on all islands */
+};
+
 /*
  * If fitting to a polynomial, each worker thread may be required to do
  * the polynomial fitting.
@@ -202,8 +300,58 @@ enum	mutants {
 	MUTANTS__MAX
 };
 
+/*
+ * How we compute the results for each lattice point.
+ */
+enum	engine {
+	ENGINE_SAMPLE = 0, /* Monte Carlo runs */
+	ENGINE_EXACT, /* Markov chain solution */
+	ENGINE_DIFFUSION, /* diffusion approximation */
+	ENGINE__MAX
+};
+
+/*
+ * How the inter-island migration probabilities are stored.
+ */
+enum	mkerneltype {
+	MKERNEL_DENSE = 0, /* full matrix */
+	MKERNEL_SPARSE, /* compressed sparse rows */
+	MKERNEL_RING, /* implicit ring neighbours */
+	MKERNEL__MAX
+};
+
+/*
+ * Non-uniform migration probabilities between "len" islands.
+ * Row entries need not be normalised.
+ */
+struct	mkernel {
+	enum mkerneltype  type;
+	size_t		  len; /* number of islands */
+	double		**ms; /* MKERNEL_DENSE rows */
+	size_t		 *rows; /* MKERNEL_SPARSE offsets (len + 1) */
+	size_t		 *cols; /* MKERNEL_SPARSE destinations */
+	double		 *vals; /* MKERNEL_SPARSE probabilities */
+	size_t		  ring; /* MKERNEL_RING neighbours (1 or 2) */
+	gsl_ran_discrete_t **tabs; /* per-row alias tables */
+};
+
+/*
+ * Payoffs of mutants ("m") and incumbents ("i") on an island of a given
+ * size with a given number of mutants.
+ * Both are kept side by side as they're always looked up together,
+ * along with the zero-term of each island's Poisson births.
+ */
+struct	payoff {
+	double		  m;
+	double		  i;
+	double		  em; /* exp(-m * mutants) */
+	double		  ei; /* exp(-i * incumbents) */
+};
+
 struct	simthr;
 struct	kml;
+struct	exact;
+struct	diffusion;
 
 /*
  * A single simulation.
@@ -220,8 +368,13 @@ struct	sim {
 	size_t		 *pops; /* non-uniform island population */
 	size_t		  islands; /* island population */
 	size_t		  refs; /* GUI references */
+	uint64_t	  seed; /* random number generator key */
 	int		  terminate; /* terminate the process */
 	enum mutants	  mutants; /* mutant assignation */
+	enum engine	  engine; /* how we compute results */
+	gint		 *sched; /* adaptive incumbent slots or NULL */
+#define	SIM_SCHED_SLOTS	  8 /* slots per incumbent */
+	size_t		  schedsz; /* slots in "sched" */
 	enum input	  input; /* input structure type */
 	double		  mutantsigma; /* mutant gaussian sigma */
 	size_t		  stop; /* when to stop */
@@ -233,7 +386,7 @@ struct	sim {
 	double		  alpha; /* outer multiplier */
 	double		  delta; /* inner multiplier */
 	double		  m; /* migration probability */
-	double		**ms; /* nonuniform migration probability */
+	struct mkernel	 *ms; /* nonuniform migration probability */
 	struct kml	 *kml; /* KML places */
 	enum mapmigrant	  migrant;
 	enum mapindex	  mapindex;
@@ -241,11 +394,17 @@ struct	sim {
 	enum maptop	  maptop;
 	size_t		  colour; /* graph colour */
 	struct hnode	**exp; /* n-player function */
+	struct hprog	 *prog; /* compiled "exp" */
+	struct hprog	**progs; /* "prog" bound to island sizes */
+	size_t		  progsz; /* entries in "progs" */
+	struct payoff	**ptabs; /* shared payoffs per lattice pair */
+	gsize		  ptabsz; /* bytes in "ptabs" (atomic) */
 	double		  xmin; /* minimum strategy */
 	double		  xmax; /* maximum strategy */
 	double		  ymin; /* minimum Gaussian mutant strategy */
 	double		  ymax; /* maximum Gaussian mutant strategy */
 	struct simbufs	  bufs; /* kdata buffers */
+	struct simacc	  acc; /* merged raw results */
 	struct simhot	  hot; /* current results */
 	struct simwarm	  warm; /* current results */
 	struct simcold	  cold; /* graphed results */
@@ -260,6 +419,7 @@ struct	simthr {
 	struct sim	 *sim;
 	GThread		 *thread;
 	size_t		  rank;
+	struct simacc	  acc; /* unmerged raw results */
 };
 
 /*
@@ -340,9 +500,11 @@ struct	hwin {
 	GtkStatusbar	 *status;
 	GtkEntry	 *mutantsigma;
 	GtkRadioButton   *mutants[MUTANTS__MAX];
+	GtkToggleButton	 *engines[ENGINE__MAX];
 	GtkToggleButton	 *namefill[NAMEFILL__MAX];
 	GtkToggleButton	 *mapmigrants[MAPMIGRANT__MAX];
 	GtkToggleButton	 *weighted;
+	GtkToggleButton	 *adaptive;
 	GtkToggleButton	 *mapindices[MAPINDEX__MAX];
 	GtkAdjustment	 *mapindexfix;
 	GtkEntry	 *stop;
@@ -419,6 +581,7 @@ struct	curwin {
  */
 struct	range {
 	struct hnode	**exp;
+	struct hprog	 *prog; /* compiled "exp" */
 	double		  alpha; /* norm outer multiplier */
 	double		  delta; /* norm inner multiplier */
 	double		  xmin; /* incumbent minimum */
@@ -450,6 +613,9 @@ struct	bmigrate {
 	struct range	  range; /* range-finding data */
 	struct kplotccfg *clrs; /* default colour palette */
 	size_t		  clrsz; /* elements in clrs */
+	int		  native; /* natively compile payoffs */
+	uint64_t	  seed; /* simulation seed (if seeded) */
+	int		  seeded; /* seed given on the command line */
 };
 
 struct	kmlplace {
@@ -468,10 +634,18 @@ __BEGIN_DECLS
 struct hnode	**hnode_parse(const char **v);
 void		  hnode_free(struct hnode **p);
 struct hnode	**hnode_copy(struct hnode **p);
+struct hnode	**hnode_bind(const struct hnode *const *p, size_t n);
 double		  hnode_exec(const struct hnode *const *p,
 			double x, double X, size_t n);
 void		  hnode_test(void);
 
+struct hprog	 *hprog_compile(const struct hnode *const *);
+double		  hprog_exec(const struct hprog *, double, double, size_t);
+void		  hprog_exec_batch(const struct hprog *, const double *,
+			const double *, const size_t *, double *, size_t);
+void		  hprog_free(struct hprog *);
+int		  hprog_native(struct hprog *, const struct hnode *const *);
+
 void		  draw(GtkWidget *, cairo_t *, struct curwin *);
 int		  save(const gchar *, struct curwin *);
 int		  saveconfig(const gchar *, const struct curwin *);
@@ -481,20 +655,57 @@ int		  rangefind(struct bmigrate *);
 
 void		  sim_stop(gpointer, gpointer);
 
+void		  simacc_free(struct simacc *);
+void		  simacc_init(struct simacc *, size_t, size_t, size_t);
+void		  simacc_merge(struct simacc *, struct simacc *);
+void		  simstat_add(struct simstat *, double);
+void		  simstat_merge(struct simstat *, const struct simstat *);
+
 void		  simbuf_copy_cold(struct simbuf *);
 void		  simbuf_copy_warm(struct simbuf *);
-void		  simbuf_copy_hotlsb(struct simbuf *);
 void		  simbuf_free(struct simbuf *);
-struct simbuf	 *simbuf_alloc(struct kdata *, size_t);
+struct simbuf	 *simbuf_alloc(size_t);
 struct simbuf	 *simbuf_alloc_warm(struct kdata *, size_t);
 
 struct kml	 *kml_parse(const gchar *file, GError **er);
 struct kml	 *kml_rand(size_t, size_t);
 struct kml	 *kml_torus(size_t, size_t);
 void		  kml_free(struct kml *kml);
-double		**kml_migration_distance(GList *, enum maptop);
-double		**kml_migration_nearest(GList *, enum maptop);
-double		**kml_migration_twonearest(GList *, enum maptop);
+struct mkernel	 *kml_migration_distance(GList *, enum maptop);
+struct mkernel	 *kml_migration_nearest(GList *, enum maptop);
+struct mkernel	 *kml_migration_twonearest(GList *, enum maptop);
+
+struct mkernel	 *mkernel_dense(double **, size_t);
+size_t		  mkernel_draw(const struct mkernel *, 
+			const gsl_rng *, size_t);
+void		  mkernel_free(struct mkernel *);
+void		  mkernel_prep(struct mkernel *);
+double		  mkernel_prob(const struct mkernel *, size_t, size_t);
+struct mkernel	 *mkernel_ring(size_t, size_t);
+void		  mkernel_scatter(const struct mkernel *, 
+			const gsl_rng *, size_t, unsigned int, 
+			size_t *, unsigned int *);
+struct mkernel	 *mkernel_sparse(size_t, size_t);
+void		  mkernel_spread(const struct mkernel *, 
+			size_t, double, double *);
+void		  mkernel_zero(const struct mkernel *, 
+			size_t, double *);
+
+extern const gsl_rng_type *rng_philox;
+void		  rng_philox_stream(gsl_rng *, uint64_t, uint64_t);
+
+struct exact	 *exact_alloc(const struct sim *);
+int		  exact_feasible(size_t, size_t, const size_t *);
+double		  exact_fixation(const struct exact *, size_t);
+void		  exact_free(struct exact *);
+int		  exact_solve(struct exact *, const struct sim *,
+			const struct payoff *const *);
+double		  exact_time(const struct exact *, size_t);
+
+struct diffusion *diffusion_alloc(const struct sim *);
+void		  diffusion_free(struct diffusion *);
+double		  diffusion_solve(struct diffusion *, 
+			const struct sim *, double, double, double *);
 
 GtkAdjustment	 *win_init_adjustment(GtkBuilder *, const gchar *);
 GtkStatusbar	 *win_init_status(GtkBuilder *, const gchar *);
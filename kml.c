@@ -26,6 +26,7 @@
 #include <glib.h>
 #include <gtk/gtk.h>
 #include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
 #include <gsl/gsl_multifit.h>
 #include <gsl/gsl_histogram.h>
 #include <kplot.h>
@@ -468,13 +469,50 @@ kml_parse(const gchar *file, GError **er)
 	return(kml);
 }
 
-double **
-kml_migration_twonearest(GList *list, enum maptop map)
+/*
+ * Flatten the list of places into an array for random access.
+ */
+static struct kmlplace **
+kml_places(GList *list, size_t *len)
+{
+	struct kmlplace	**p;
+	size_t		  i;
+
+	*len = (size_t)g_list_length(list);
+	g_assert(*len > 0);
+	p = g_malloc0_n(*len, sizeof(struct kmlplace *));
+	for (i = 0; NULL != list; list = g_list_next(list), i++)
+		p[i] = list->data;
+	return(p);
+}
+
+/*
+ * Find the island nearest to "i" that is neither "i" nor "skip".
+ * Returns "len" if there is no such island.
+ */
+static size_t
+kml_nearest(struct kmlplace **pl, size_t len, size_t i, size_t skip)
 {
-	double		**p;
 	double		  dist, min;
-	size_t		  i, j, len, minj, min2j;
-	struct kmlplace	 *pl1, *pl2;
+	size_t		  j, minj;
+
+	for (minj = len, j = 0, min = DBL_MAX; j < len; j++) {
+		if (i == j || skip == j)
+			continue;
+		if ((dist = kml_dist(pl[i], pl[j])) < min) {
+			min = dist;
+			minj = j;
+		}
+	}
+	return(minj);
+}
+
+struct mkernel *
+kml_migration_twonearest(GList *list, enum maptop map)
+{
+	struct mkernel	 *p;
+	struct kmlplace	**pl;
+	size_t		  i, k, len, minj, min2j;
 
 	len = (size_t)g_list_length(list);
 	g_assert(len > 0);
@@ -484,122 +522,92 @@ kml_migration_twonearest(GList *list, enum maptop map)
 		return(kml_migration_nearest(list, map));
 	}
 
-	p = g_malloc0_n(len, sizeof(double *));
-
 	/* 
 	 * Special case the torus, which has a well-defined layout
 	 * between nodes, such that the next ("right") and previous
 	 * ("left") islands, wrapping around, get the migrants.
+	 * This needs no storage at all.
 	 */
-	if (MAPTOP_TORUS == map) {
-		for (i = 0; i < len; i++) {
-			p[i] = g_malloc0_n(len, sizeof(double));
-			if (i < len - 1)
-				p[i][i + 1] = 0.5;
-			else
-				p[i][0] = 0.5;
-			if (i > 0)
-				p[i][i - 1] = 0.5;
-			else
-				p[i][len - 1] = 0.5;
-		}
-		return(p);
-	}
-
-	for (i = 0; i < len; i++) {
-		pl1 = g_list_nth_data(list, i);
-		p[i] = g_malloc0_n(len, sizeof(double));
-		for (minj = j = 0, min = DBL_MAX; j < len; j++) {
-			if (i == j)
-				continue;
-			pl2 = g_list_nth_data(list, j);
-			if ((dist = kml_dist(pl1, pl2)) < min) {
-				min = dist;
-				minj = j;
-			}
-		}
-		p[i][minj] = 0.5;
-		for (min2j = j = 0, min = DBL_MAX; j < len; j++) {
-			if (i == j || j == minj)
-				continue;
-			pl2 = g_list_nth_data(list, j);
-			if ((dist = kml_dist(pl1, pl2)) < min) {
-				min = dist;
-				min2j = j;
-			}
-		}
-		p[i][min2j] = 0.5;
+	if (MAPTOP_TORUS == map)
+		return(mkernel_ring(len, 2));
+
+	pl = kml_places(list, &len);
+	p = mkernel_sparse(len, 2 * len);
+	for (k = i = 0; i < len; i++) {
+		p->rows[i] = k;
+		minj = kml_nearest(pl, len, i, len);
+		g_assert(minj < len);
+		p->cols[k] = minj;
+		p->vals[k++] = 0.5;
+		min2j = kml_nearest(pl, len, i, minj);
+		if (min2j == len)
+			continue;
 		g_assert(min2j != minj);
 		g_assert(i != min2j);
+		p->cols[k] = min2j;
+		p->vals[k++] = 0.5;
 	}
+	p->rows[len] = k;
 
+	g_free(pl);
 	return(p);
 }
 
-double **
+struct mkernel *
 kml_migration_nearest(GList *list, enum maptop map)
 {
-	double		**p;
-	double		  dist, min;
-	size_t		  i, j, len, minj;
-	struct kmlplace	 *pl1, *pl2;
+	struct mkernel	 *p;
+	struct kmlplace	**pl;
+	size_t		  i, k, len, minj;
 
 	len = (size_t)g_list_length(list);
 	g_assert(len > 0);
-	p = g_malloc0_n(len, sizeof(double *));
 
 	/* 
 	 * Special case the torus, which has a well-defined layout
 	 * between nodes, such that the next ("right") island, wrapping
 	 * around, gets the migrant.
 	 */
-	if (MAPTOP_TORUS == map) {
-		for (i = 0; i < len; i++) {
-			p[i] = g_malloc0_n(len, sizeof(double));
-			p[i][(i + 1) % len] = 1.0;
-		}
-		return(p);
-	}
+	if (MAPTOP_TORUS == map)
+		return(mkernel_ring(len, 1));
 
-	for (i = 0; i < len; i++) {
-		pl1 = g_list_nth_data(list, i);
-		p[i] = g_malloc0_n(len, sizeof(double));
-		for (minj = j = 0, min = DBL_MAX; j < len; j++) {
-			if (i == j)
-				continue;
-			pl2 = g_list_nth_data(list, j);
-			if ((dist = kml_dist(pl1, pl2)) < min) {
-				min = dist;
-				minj = j;
-			}
-		}
-		p[i][minj] = 1.0;
+	/*
+	 * A lone island has no neighbour and so an empty row.
+	 * (We won't simulate with fewer than two islands anyway.)
+	 */
+	pl = kml_places(list, &len);
+	p = mkernel_sparse(len, len);
+	for (k = i = 0; i < len; i++) {
+		p->rows[i] = k;
+		if ((minj = kml_nearest(pl, len, i, len)) == len)
+			continue;
+		p->cols[k] = minj;
+		p->vals[k++] = 1.0;
 	}
+	p->rows[len] = k;
 
+	g_free(pl);
 	return(p);
 }
 
-double **
+struct mkernel *
 kml_migration_distance(GList *list, enum maptop map)
 {
 	double		**p;
 	double		  dist, sum;
 	size_t		  i, j, len;
-	struct kmlplace	 *pl1, *pl2;
+	struct kmlplace	**pl;
 
-	len = (size_t)g_list_length(list);
-	g_assert(len > 0);
+	pl = kml_places(list, &len);
 	p = g_malloc0_n(len, sizeof(double *));
 	for (i = 0; i < len; i++) {
-		pl1 = g_list_nth_data(list, i);
 		p[i] = g_malloc0_n(len, sizeof(double));
 		for (sum = 0.0, j = 0; j < len; j++) {
 			if (i == j) {
 				p[i][j] = 0.0;
 				continue;
 			}
-			pl2 = g_list_nth_data(list, j);
-			dist = kml_dist(pl1, pl2);
+			dist = kml_dist(pl[i], pl[j]);
 			p[i][j] = 1.0 / (dist * dist);
 			sum += p[i][j];
 		}
@@ -608,5 +616,6 @@ kml_migration_distance(GList *list, enum maptop map)
 				p[i][j] = p[i][j] / sum;
 	}
 
-	return(p);
+	g_free(pl);
+	return(mkernel_dense(p, len));
 }
@@ -0,0 +1,325 @@
+/*	$Id$ */
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtk/gtk.h>
+#include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
+#include <gsl/gsl_multifit.h>
+#include <gsl/gsl_histogram.h>
+#include <kplot.h>
+
+#include "extern.h"
+
+/*
+ * Wrap the "len" by "len" matrix "ms" in a kernel, which then owns it.
+ */
+struct mkernel *
+mkernel_dense(double **ms, size_t len)
+{
+	struct mkernel	*p;
+
+	p = g_malloc0(sizeof(struct mkernel));
+	p->type = MKERNEL_DENSE;
+	p->len = len;
+	p->ms = ms;
+	return(p);
+}
+
+/*
+ * Allocate a compressed sparse-row kernel over "len" islands with room
+ * for "nnz" non-zero probabilities.
+ * The caller must fill in "rows", "cols", and "vals".
+ */
+struct mkernel *
+mkernel_sparse(size_t len, size_t nnz)
+{
+	struct mkernel	*p;
+
+	p = g_malloc0(sizeof(struct mkernel));
+	p->type = MKERNEL_SPARSE;
+	p->len = len;
+	p->rows = g_malloc0_n(len + 1, sizeof(size_t));
+	p->cols = g_malloc0_n(nnz, sizeof(size_t));
+	p->vals = g_malloc0_n(nnz, sizeof(double));
+	return(p);
+}
+
+/*
+ * Allocate an implicit kernel over a ring of "len" islands.
+ * If "ring" is 1, migrants go to the next island; if 2, they go evenly
+ * to the next and previous islands.
+ */
+struct mkernel *
+mkernel_ring(size_t len, size_t ring)
+{
+	struct mkernel	*p;
+
+	g_assert(1 == ring || 2 == ring);
+	p = g_malloc0(sizeof(struct mkernel));
+	p->type = MKERNEL_RING;
+	p->len = len;
+	p->ring = ring;
+	return(p);
+}
+
+void
+mkernel_free(struct mkernel *p)
+{
+	size_t	 i;
+
+	if (NULL == p)
+		return;
+
+	if (NULL != p->tabs)
+		for (i = 0; i < p->len; i++)
+			if (NULL != p->tabs[i])
+				gsl_ran_discrete_free(p->tabs[i]);
+	if (NULL != p->ms)
+		for (i = 0; i < p->len; i++)
+			g_free(p->ms[i]);
+
+	g_free(p->tabs);
+	g_free(p->ms);
+	g_free(p->rows);
+	g_free(p->cols);
+	g_free(p->vals);
+	g_free(p);
+}
+
+/*
+ * Precompute Walker alias tables for each island's row so that drawing
+ * a single destination takes constant time.
+ * For dense rows, the island itself is never a destination, so leave
+ * it out of the table lest rounding give it a non-zero weight.
+ * Sparse rows with only one destination and rings need no table.
+ */
+void
+mkernel_prep(struct mkernel *p)
+{
+	size_t	 i, sz;
+	double	*row;
+
+	switch (p->type) {
+	case (MKERNEL_DENSE):
+		p->tabs = g_malloc0_n
+			(p->len, sizeof(gsl_ran_discrete_t *));
+		row = g_malloc0_n(p->len - 1, sizeof(double));
+		for (i = 0; i < p->len; i++) {
+			memcpy(row, p->ms[i], i * sizeof(double));
+			memcpy(row + i, p->ms[i] + i + 1,
+				(p->len - i - 1) * sizeof(double));
+			p->tabs[i] = gsl_ran_discrete_preproc
+				(p->len - 1, row);
+			g_assert(NULL != p->tabs[i]);
+		}
+		g_free(row);
+		break;
+	case (MKERNEL_SPARSE):
+		p->tabs = g_malloc0_n
+			(p->len, sizeof(gsl_ran_discrete_t *));
+		for (i = 0; i < p->len; i++) {
+			sz = p->rows[i + 1] - p->rows[i];
+			if (sz < 2)
+				continue;
+			p->tabs[i] = gsl_ran_discrete_preproc
+				(sz, p->vals + p->rows[i]);
+			g_assert(NULL != p->tabs[i]);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Draw the destination of a single migrant leaving island "from".
+ */
+size_t
+mkernel_draw(const struct mkernel *p, const gsl_rng *rng, size_t from)
+{
+	size_t	 i, off;
+
+	switch (p->type) {
+	case (MKERNEL_DENSE):
+		i = gsl_ran_discrete(rng, p->tabs[from]);
+		return(i >= from ? i + 1 : i);
+	case (MKERNEL_SPARSE):
+		off = p->rows[from];
+		g_assert(p->rows[from + 1] > off);
+		if (NULL == p->tabs[from])
+			return(p->cols[off]);
+		return(p->cols[off +
+			gsl_ran_discrete(rng, p->tabs[from])]);
+	case (MKERNEL_RING):
+		if (1 == p->ring || gsl_rng_uniform(rng) < 0.5)
+			return((from + 1) % p->len);
+		return((from + p->len - 1) % p->len);
+	default:
+		break;
+	}
+
+	abort();
+}
+
+/*
+ * Add "w" times the probability of moving from island "from" to each
+ * destination into "to".
+ */
+void
+mkernel_spread(const struct mkernel *p, size_t from, double w, double *to)
+{
+	size_t	 i;
+
+	switch (p->type) {
+	case (MKERNEL_DENSE):
+		for (i = 0; i < p->len; i++)
+			to[i] += w * p->ms[from][i];
+		break;
+	case (MKERNEL_SPARSE):
+		for (i = p->rows[from]; i < p->rows[from + 1]; i++)
+			to[p->cols[i]] += w * p->vals[i];
+		break;
+	case (MKERNEL_RING):
+		if (1 == p->ring) {
+			to[(from + 1) % p->len] += w;
+			break;
+		}
+		to[(from + 1) % p->len] += w * 0.5;
+		to[(from + p->len - 1) % p->len] += w * 0.5;
+		break;
+	default:
+		abort();
+	}
+}
+
+/*
+ * The probability of moving from island "from" to "to", i.e., what
+ * mkernel_spread() would add into "to" with unit weight.
+ */
+double
+mkernel_prob(const struct mkernel *p, size_t from, size_t to)
+{
+	size_t	 i;
+	double	 v;
+
+	switch (p->type) {
+	case (MKERNEL_DENSE):
+		return(p->ms[from][to]);
+	case (MKERNEL_SPARSE):
+		v = 0.0;
+		for (i = p->rows[from]; i < p->rows[from + 1]; i++)
+			if (to == p->cols[i])
+				v += p->vals[i];
+		return(v);
+	case (MKERNEL_RING):
+		v = 0.0;
+		if (to == (from + 1) % p->len)
+			v += 1 == p->ring ? 1.0 : 0.5;
+		if (2 == p->ring && to == (from + p->len - 1) % p->len)
+			v += 0.5;
+		return(v);
+	default:
+		break;
+	}
+
+	abort();
+}
+
+/*
+ * Zero the entries of "to" that mkernel_spread() would add into for
+ * island "from".
+ */
+void
+mkernel_zero(const struct mkernel *p, size_t from, double *to)
+{
+	size_t	 i;
+
+	switch (p->type) {
+	case (MKERNEL_DENSE):
+		memset(to, 0, p->len * sizeof(double));
+		break;
+	case (MKERNEL_SPARSE):
+		for (i = p->rows[from]; i < p->rows[from + 1]; i++)
+			to[p->cols[i]] = 0.0;
+		break;
+	case (MKERNEL_RING):
+		to[(from + 1) % p->len] = 0.0;
+		to[(from + p->len - 1) % p->len] = 0.0;
+		break;
+	default:
+		abort();
+	}
+}
+
+/*
+ * Scatter "n" migrants leaving island "from" over their destinations,
+ * accumulating into "migrants".
+ * The "counts" buffer is scratch space of at least "len" entries.
+ * Dense rows are drawn one migrant at a time when there are fewer
+ * migrants than destinations, else with one multinomial draw; sparse
+ * rows and rings are always split in time proportional to the number
+ * of neighbours.
+ */
+void
+mkernel_scatter(const struct mkernel *p, const gsl_rng *rng,
+	size_t from, unsigned int n, size_t *migrants,
+	unsigned int *counts)
+{
+	size_t		 i, off, sz;
+	unsigned int	 k;
+
+	if (0 == n)
+		return;
+
+	switch (p->type) {
+	case (MKERNEL_DENSE):
+		if (n < p->len - 1) {
+			while (n-- > 0)
+				migrants[mkernel_draw(p, rng, from)]++;
+			break;
+		}
+		gsl_ran_multinomial(rng, p->len,
+			n, p->ms[from], counts);
+		g_assert(0 == counts[from]);
+		for (i = 0; i < p->len; i++)
+			migrants[i] += counts[i];
+		break;
+	case (MKERNEL_SPARSE):
+		off = p->rows[from];
+		sz = p->rows[from + 1] - off;
+		g_assert(sz > 0);
+		if (1 == sz) {
+			migrants[p->cols[off]] += n;
+			break;
+		}
+		gsl_ran_multinomial(rng, sz, n, p->vals + off, counts);
+		for (i = 0; i < sz; i++)
+			migrants[p->cols[off + i]] += counts[i];
+		break;
+	case (MKERNEL_RING):
+		k = 1 == p->ring ? n : gsl_ran_binomial(rng, 0.5, n);
+		migrants[(from + 1) % p->len] += k;
+		migrants[(from + p->len - 1) % p->len] += n - k;
+		break;
+	default:
+		abort();
+	}
+}
@@ -14,8 +14,11 @@
  * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
+#include <sys/wait.h>
+
 #include <assert.h>
 #include <ctype.h>
+#include <dlfcn.h>
 #include <math.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -23,7 +26,9 @@
 #include <string.h>
 
 #include <gtk/gtk.h>
+#include <glib/gstdio.h>
 #include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
 #include <gsl/gsl_multifit.h>
 #include <gsl/gsl_histogram.h>
 #include <kplot.h>
@@ -298,7 +303,10 @@ check(struct hnode **p)
 	struct hnode	**pp;
 	size_t		  ssz;
 
-	for (ssz = 0, pp = p; NULL != *pp; pp++)
+	for (ssz = 0, pp = p; NULL != *pp; pp++) {
+		/* Bound the registers of hprog_compile(). */
+		if (pp - p >= EXPRSZ)
+			return(0);
 		switch ((*pp)->type) {
 		case (HNODE_P1):
 			/* FALLTHROUGH */
@@ -307,7 +315,9 @@ check(struct hnode **p)
 		case (HNODE_N):
 			/* FALLTHROUGH */
 		case (HNODE_NUMBER):
-			ssz++;
+			/* Bound the evaluation stacks. */
+			if (++ssz > STACKSZ)
+				return(0);
 			break;
 		case (HNODE_POSITIVE):
 			/* FALLTHROUGH */
@@ -335,10 +345,236 @@ check(struct hnode **p)
 		default:
 			abort();
 		}
+	}
 
 	return(1 == ssz);
 }
 
+/*
+ * A subexpression on the optimiser's stack.
+ * It spans the output list from "off" to the start of the next one on
+ * the stack (or the end of the list).
+ */
+struct	hspan {
+	size_t		 off; /* start in output list */
+	size_t		 depth; /* evaluation stack needed */
+	int		 isk; /* is a lone constant */
+	double		 k; /* constant (if constant) */
+};
+
+static struct hnode *
+hnode_alloc(enum htype type, double real)
+{
+	struct hnode	*p;
+
+	p = calloc(1, sizeof(struct hnode));
+	assert(NULL != p);
+	p->type = type;
+	p->real = real;
+	return(p);
+}
+
+/*
+ * Apply an operation to constants just as hnode_exec() would.
+ */
+static double
+fold(enum htype type, double a, double b)
+{
+
+	switch (type) {
+	case (HNODE_SQRT):
+		return(sqrt(a));
+	case (HNODE_EXPF):
+		return(exp(a));
+	case (HNODE_NEGATIVE):
+		return(-a);
+	case (HNODE_ADD):
+		return(a + b);
+	case (HNODE_SUB):
+		return(a - b);
+	case (HNODE_MUL):
+		return(a * b);
+	case (HNODE_DIV):
+		return(a / b);
+	case (HNODE_EXP):
+		return(pow(a, b));
+	default:
+		break;
+	}
+
+	abort();
+}
+
+/*
+ * Rewrite "a ^ k" for the small integer "k", where "a" is "s" on the
+ * stack, with "base" entries beneath it, spanning from its offset to
+ * "*len" in "out", and "n" is the exponentiation node.
+ * Powers of two to four become repeated multiplication of copies of
+ * "a" (hprog_compile() evaluates the copies only once) and -1 becomes
+ * division.
+ * Return zero (doing nothing) if "k" isn't one of these, the result,
+ * with the "rest" input nodes still to be appended, would be longer
+ * than "max", or evaluating it would overflow the stack.
+ */
+static int
+optimise_pow(struct hnode **out, size_t *len, struct hspan *s,
+	size_t base, struct hnode *n, double k, size_t rest, size_t max)
+{
+	size_t	 i, span, end, depth, off = s->off;
+
+	span = *len - off;
+	depth = s->depth + 1;
+	if (k == 2.0 || k == 3.0)
+		end = *len + (span + 1) * (size_t)(k - 1.0);
+	else if (k == 4.0) {
+		end = *len + span * 3 + 3;
+		depth++;
+	} else if (k == -1.0)
+		end = *len + 2;
+	else
+		return(0);
+
+	if (end + rest > max || base + depth > STACKSZ)
+		return(0);
+	s->depth = depth;
+
+	if (k == -1.0) {
+		memmove(&out[off + 1], &out[off], 
+			span * sizeof(struct hnode *));
+		out[off] = hnode_alloc(HNODE_NUMBER, 1.0);
+		(*len)++;
+		n->type = HNODE_DIV;
+		out[(*len)++] = n;
+		return(1);
+	}
+
+	for (i = 0; i < span; i++)
+		out[(*len)++] = hnode_alloc
+			(out[off + i]->type, out[off + i]->real);
+	out[(*len)++] = hnode_alloc(HNODE_MUL, 0.0);
+
+	if (k == 3.0) {
+		for (i = 0; i < span; i++)
+			out[(*len)++] = hnode_alloc
+				(out[off + i]->type, out[off + i]->real);
+		out[(*len)++] = hnode_alloc(HNODE_MUL, 0.0);
+	} else if (k == 4.0) {
+		span = *len - off;
+		for (i = 0; i < span; i++)
+			out[(*len)++] = hnode_alloc
+				(out[off + i]->type, out[off + i]->real);
+		out[(*len)++] = hnode_alloc(HNODE_MUL, 0.0);
+	}
+
+	free(n);
+	return(1);
+}
+
+/*
+ * Simplify a checked postfix list, freeing it and returning the result.
+ * Operations on constants are folded into constants, unary plus and
+ * double negation are dropped, and small integral powers are rewritten
+ * by optimise_pow().
+ * Common subexpressions are left to hprog_compile(), since the list
+ * itself has no way of sharing values.
+ */
+static struct hnode **
+optimise(struct hnode **p)
+{
+	struct hspan	  stack[STACKSZ];
+	struct hnode	**out, **pp, *n;
+	struct hspan	 *a, *b;
+	size_t		  ssz, len, rest, max;
+
+	/*
+	 * Each input node adds at most one output node, save for
+	 * expanded powers, so "rest" bounds what's still to come.
+	 * Expanding powers may add at most STACKSZ nodes in all.
+	 */
+	for (rest = 0; NULL != p[rest]; rest++)
+		/* Count input nodes. */ ;
+	max = rest + STACKSZ;
+
+	out = calloc(max + 1, sizeof(struct hnode *));
+	assert(NULL != out);
+
+	for (ssz = len = 0, pp = p; NULL != (n = *pp); pp++) {
+		rest--;
+		switch (n->type) {
+		case (HNODE_P1):
+			/* FALLTHROUGH */
+		case (HNODE_PN):
+			/* FALLTHROUGH */
+		case (HNODE_N):
+			/* FALLTHROUGH */
+		case (HNODE_NUMBER):
+			assert(ssz < STACKSZ && len < max);
+			stack[ssz].off = len;
+			stack[ssz].depth = 1;
+			stack[ssz].isk = HNODE_NUMBER == n->type;
+			stack[ssz++].k = n->real;
+			out[len++] = n;
+			break;
+		case (HNODE_POSITIVE):
+			free(n);
+			break;
+		case (HNODE_SQRT):
+			/* FALLTHROUGH */
+		case (HNODE_EXPF):
+			/* FALLTHROUGH */
+		case (HNODE_NEGATIVE):
+			assert(ssz > 0);
+			a = &stack[ssz - 1];
+			if (a->isk) {
+				a->k = fold(n->type, a->k, 0.0);
+				out[len - 1]->real = a->k;
+				free(n);
+			} else if (HNODE_NEGATIVE == n->type &&
+			    HNODE_NEGATIVE == out[len - 1]->type) {
+				free(out[--len]);
+				free(n);
+			} else
+				out[len++] = n;
+			break;
+		default:
+			assert(ssz > 1);
+			a = &stack[ssz - 2];
+			b = &stack[ssz - 1];
+			ssz--;
+			if (a->isk && b->isk) {
+				a->k = fold(n->type, a->k, b->k);
+				out[a->off]->real = a->k;
+				free(out[--len]);
+				free(n);
+				break;
+			} 
+			a->isk = 0;
+			if (HNODE_EXP == n->type && b->isk) {
+				if (1.0 == b->k) {
+					free(out[--len]);
+					free(n);
+					break;
+				}
+				free(out[--len]);
+				if (optimise_pow(out, &len, a, 
+				    ssz - 1, n, b->k, rest, max))
+					break;
+				out[len++] = hnode_alloc
+					(HNODE_NUMBER, b->k);
+			}
+			if (a->depth < b->depth + 1)
+				a->depth = b->depth + 1;
+			out[len++] = n;
+			break;
+		}
+	}
+
+	assert(1 == ssz);
+	out[len] = NULL;
+	free(p);
+	return(out);
+}
+
 /*
  * Dijkstra's Shunting-Yard algorithm for converting an infix-order
  * expression to prefix order.
@@ -381,7 +617,8 @@ hnode_parse(const char **v)
 		case (TOKEN_EXPF):
 			/* FALLTHROUGH */
 		case (TOKEN_PAREN_OPEN):
-			assert(ssz < STACKSZ);
+			if (ssz >= STACKSZ)
+				goto err;
 			stack[ssz++] = tok;
 			break;
 		case (TOKEN_PAREN_CLOSE):
@@ -425,7 +662,8 @@ hnode_parse(const char **v)
 				else
 					break;
 			}
-			assert(ssz < STACKSZ);
+			if (ssz >= STACKSZ)
+				goto err;
 			stack[ssz++] = tok;
 			break;
 		default:
@@ -448,6 +686,8 @@ hnode_parse(const char **v)
 	if ( ! check(q))
 		goto err;
 
+	q = optimise(q);
+
 #if 0
 	hnode_print(q);
 #endif
@@ -478,6 +718,25 @@ hnode_copy(struct hnode **p)
 	return(pp);
 }
 
+/*
+ * Copy the expression with the number of players bound to "n", then
+ * simplify it again so that terms only in "n" become constants.
+ */
+struct hnode **
+hnode_bind(const struct hnode *const *p, size_t n)
+{
+	struct hnode	**q, **pp;
+
+	q = hnode_copy((struct hnode **)p);
+	for (pp = q; NULL != *pp; pp++)
+		if (HNODE_N == (*pp)->type) {
+			(*pp)->type = HNODE_NUMBER;
+			(*pp)->real = (double)n;
+		}
+
+	return(optimise(q));
+}
+
 void
 hnode_free(struct hnode **p)
 {
@@ -579,12 +838,703 @@ hnode_exec(const struct hnode *const *p, double x, double X, size_t n)
 	return(stack[0]);
 }
 
+/*
+ * A value on the compile-time stack: either a register or a constant
+ * that we haven't yet needed to load.
+ */
+struct	hval {
+	int		  isk; /* is a constant */
+	unsigned short	  reg; /* register (if not constant) */
+	double		  k; /* constant (if constant) */
+};
+
+static struct hins *
+hprog_emit(struct hprog *p, enum hop op)
+{
+	struct hins	*in;
+
+	assert(p->regs < HREG__MAX);
+	p->ins = realloc(p->ins, ++p->len * sizeof(struct hins));
+	in = &p->ins[p->len - 1];
+	memset(in, 0, sizeof(struct hins));
+	in->op = op;
+	in->dst = p->regs++;
+	return(in);
+}
+
+/*
+ * Look for an earlier instruction computing the same value as the one
+ * just emitted.
+ * Registers are only ever written once, so if there is one, its result
+ * is still there and we can drop the new instruction.
+ * Return the register holding the value.
+ */
+static unsigned short
+hprog_cse(struct hprog *p)
+{
+	const struct hins *in, *last;
+
+	last = &p->ins[p->len - 1];
+	for (in = p->ins; in < last; in++)
+		if (in->op == last->op && 
+		    in->a == last->a && 
+		    in->b == last->b && 
+		    in->c == last->c &&
+		    0 == memcmp(&in->k, &last->k, sizeof(double))) {
+			p->len--;
+			p->regs--;
+			return(in->dst);
+		}
+
+	return(last->dst);
+}
+
+/*
+ * Make sure that the value is in a register, loading it if it's a
+ * constant.
+ */
+static unsigned short
+hprog_reg(struct hprog *p, struct hval *v)
+{
+
+	if ( ! v->isk)
+		return(v->reg);
+	hprog_emit(p, HOP_LOADK)->k = v->k;
+	v->isk = 0;
+	v->reg = hprog_cse(p);
+	return(v->reg);
+}
+
+/*
+ * Emit a binary operation on "a" and "b", folding constant operands
+ * into the instruction where we have a form for it.
+ * Return the register holding the result.
+ */
+static unsigned short
+hprog_binary(struct hprog *p, enum htype type, 
+	struct hval *a, struct hval *b)
+{
+	struct hins	*in;
+	enum hop	 op, opk, opr;
+	unsigned short	 reg;
+
+	switch (type) {
+	case (HNODE_ADD):
+		op = HOP_ADD;
+		opk = opr = HOP_ADDK;
+		break;
+	case (HNODE_SUB):
+		op = HOP_SUB;
+		opk = HOP_SUBK;
+		opr = HOP_RSUBK;
+		break;
+	case (HNODE_MUL):
+		op = HOP_MUL;
+		opk = opr = HOP_MULK;
+		break;
+	case (HNODE_DIV):
+		op = HOP_DIV;
+		opk = HOP_DIVK;
+		opr = HOP_RDIVK;
+		break;
+	case (HNODE_EXP):
+		op = HOP_POW;
+		opk = HOP_POWK;
+		opr = HOP__MAX;
+		break;
+	default:
+		abort();
+	}
+
+	if (a->isk && b->isk)
+		hprog_reg(p, a);
+
+	if (b->isk) {
+		if (HOP_POWK == opk && 2.0 == b->k) {
+			in = hprog_emit(p, HOP_SQ);
+		} else {
+			in = hprog_emit(p, opk);
+			in->k = b->k;
+		}
+		in->a = a->reg;
+	} else if (a->isk && HOP__MAX != opr) {
+		in = hprog_emit(p, opr);
+		in->a = b->reg;
+		in->k = a->k;
+	} else {
+		hprog_reg(p, a);
+		in = hprog_emit(p, op);
+		in->a = a->reg;
+		in->b = b->reg;
+		/* Commute so that CSE sees "x*y" and "y*x" as one. */
+		if ((HOP_ADD == op || HOP_MUL == op) && in->a > in->b) {
+			reg = in->a;
+			in->a = in->b;
+			in->b = reg;
+		}
+	}
+
+	return(hprog_cse(p));
+}
+
+/*
+ * Fuse a multiplication into a temporary that's immediately added to or
+ * subtracted from another register.
+ * Only do so if nothing else uses the product, as it's dropped.
+ */
+static void
+hprog_fuse(struct hprog *p)
+{
+	struct hins	*mul, *in;
+	size_t		 i, j;
+	size_t		*uses;
+
+	/* Unused operands are zero, which is never a temporary. */
+	uses = calloc(p->regs, sizeof(size_t));
+	assert(NULL != uses);
+	for (i = 0; i < p->len; i++) {
+		uses[p->ins[i].a]++;
+		uses[p->ins[i].b]++;
+		uses[p->ins[i].c]++;
+	}
+	uses[p->res]++;
+
+	for (i = j = 0; i < p->len; i++, j++) {
+		p->ins[j] = p->ins[i];
+		if (0 == j || HOP_MUL != p->ins[j - 1].op)
+			continue;
+		mul = &p->ins[j - 1];
+		in = &p->ins[j];
+		if (1 != uses[mul->dst])
+			continue;
+		if (HOP_ADD == in->op && in->a == mul->dst) {
+			mul->op = HOP_MADD;
+			mul->c = in->b;
+		} else if (HOP_ADD == in->op && in->b == mul->dst) {
+			mul->op = HOP_MADD;
+			mul->c = in->a;
+		} else if (HOP_SUB == in->op && in->a == mul->dst) {
+			mul->op = HOP_MSUB;
+			mul->c = in->b;
+		} else if (HOP_SUB == in->op && in->b == mul->dst) {
+			mul->op = HOP_NMADD;
+			mul->c = in->a;
+		} else
+			continue;
+		mul->dst = in->dst;
+		j--;
+	}
+	p->len = j;
+	free(uses);
+}
+
+/*
+ * Compile a postfix expression (which must have passed check(), as all
+ * of those from hnode_parse() have) into register instructions.
+ * Each instruction writes its own register and inputs are referenced
+ * directly by register, so loads are only needed for constants that
+ * can't be folded into an instruction.
+ * Since registers are never overwritten, common subexpressions are
+ * found by looking for an earlier identical instruction.
+ */
+struct hprog *
+hprog_compile(const struct hnode *const *pp)
+{
+	struct hprog	*p;
+	struct hval	 stack[STACKSZ];
+	size_t		 ssz;
+	unsigned short	 reg;
+
+	p = calloc(1, sizeof(struct hprog));
+	assert(NULL != p);
+	p->regs = HREG_N + 1;
+
+	for (ssz = 0; NULL != *pp; pp++) {
+		switch ((*pp)->type) {
+		case (HNODE_P1):
+			/* FALLTHROUGH */
+		case (HNODE_PN):
+			/* FALLTHROUGH */
+		case (HNODE_N):
+			assert(ssz < STACKSZ);
+			stack[ssz].isk = 0;
+			stack[ssz++].reg = 
+				HNODE_P1 == (*pp)->type ? HREG_P1 :
+				HNODE_PN == (*pp)->type ? HREG_PN : 
+				HREG_N;
+			break;
+		case (HNODE_NUMBER):
+			assert(ssz < STACKSZ);
+			stack[ssz].isk = 1;
+			stack[ssz++].k = (*pp)->real;
+			break;
+		case (HNODE_POSITIVE):
+			assert(ssz > 0);
+			break;
+		case (HNODE_SQRT):
+			/* FALLTHROUGH */
+		case (HNODE_EXPF):
+			/* FALLTHROUGH */
+		case (HNODE_NEGATIVE):
+			assert(ssz > 0);
+			reg = hprog_reg(p, &stack[ssz - 1]);
+			hprog_emit(p, 
+				HNODE_SQRT == (*pp)->type ? HOP_SQRT :
+				HNODE_EXPF == (*pp)->type ? HOP_EXPF :
+				HOP_NEG)->a = reg;
+			stack[ssz - 1].reg = hprog_cse(p);
+			break;
+		default:
+			assert(ssz > 1);
+			reg = hprog_binary(p, (*pp)->type, 
+				&stack[ssz - 2], &stack[ssz - 1]);
+			ssz--;
+			stack[ssz - 1].isk = 0;
+			stack[ssz - 1].reg = reg;
+			break;
+		}
+	}
+
+	assert(1 == ssz);
+	p->res = hprog_reg(p, &stack[0]);
+	hprog_fuse(p);
+	return(p);
+}
+
+void
+hprog_free(struct hprog *p)
+{
+
+	if (NULL == p)
+		return;
+	if (NULL != p->cc)
+		g_thread_join(p->cc);
+	if (NULL != p->dl)
+		dlclose(p->dl);
+	free(p->ins);
+	free(p);
+}
+
+/*
+ * A pending native compilation of "src" into "p".
+ */
+struct	hcc {
+	struct hprog	*p;
+	GString		*src;
+};
+
+/*
+ * Compile the source of a native compilation with the system compiler
+ * into a shared object, then load it into the program.
+ * This runs in its own thread: the compiler may take seconds.
+ * Until it finishes, hprog_exec() interprets the program.
+ */
+static gpointer
+hprog_cc(gpointer arg)
+{
+	struct hcc	*cc = arg;
+	struct hprog	*p = cc->p;
+	GString		*src = cc->src;
+	gchar		*dir, *cfile, *sofile;
+	const gchar	*argv[9];
+	gint		 st;
+	gboolean	 rc;
+	void		*dl, *fn;
+
+	g_free(cc);
+	dl = fn = NULL;
+	cfile = sofile = NULL;
+	if (NULL == (dir = g_dir_make_tmp("bmigrate-XXXXXX", NULL))) {
+		g_string_free(src, TRUE);
+		return(NULL);
+	}
+
+	cfile = g_build_filename(dir, "pi.c", NULL);
+	sofile = g_build_filename(dir, "pi.so", NULL);
+	if ( ! g_file_set_contents(cfile, src->str, src->len, NULL))
+		goto out;
+
+	argv[0] = "cc";
+	argv[1] = "-O3";
+	argv[2] = "-shared";
+	argv[3] = "-fPIC";
+	argv[4] = "-o";
+	argv[5] = sofile;
+	argv[6] = cfile;
+	argv[7] = "-lm";
+	argv[8] = NULL;
+
+	rc = g_spawn_sync(NULL, (gchar **)argv, NULL, 
+		G_SPAWN_SEARCH_PATH | 
+		G_SPAWN_STDOUT_TO_DEV_NULL | 
+		G_SPAWN_STDERR_TO_DEV_NULL, 
+		NULL, NULL, NULL, NULL, &st, NULL);
+	if ( ! rc || ! WIFEXITED(st) || 0 != WEXITSTATUS(st)) {
+		g_debug("Native compilation failed");
+		goto out;
+	}
+
+	if (NULL == (dl = dlopen(sofile, RTLD_NOW | RTLD_LOCAL))) {
+		g_debug("%s: %s", sofile, dlerror());
+		goto out;
+	} else if (NULL == (fn = dlsym(dl, "bmigrate_pi"))) {
+		g_debug("%s: %s", sofile, dlerror());
+		dlclose(dl);
+		dl = NULL;
+		goto out;
+	}
+
+	/* Simulation threads may already be running "p". */
+	p->dl = dl;
+	g_atomic_pointer_set(&p->fn, 
+		(double (*)(double, double, double))fn);
+	g_debug("Native compilation: %s", sofile);
+out:
+	/* The object stays mapped after we unlink it. */
+	g_unlink(sofile);
+	g_unlink(cfile);
+	g_rmdir(dir);
+	g_free(sofile);
+	g_free(cfile);
+	g_free(dir);
+	g_string_free(src, TRUE);
+	return(NULL);
+}
+
+/*
+ * Translate the postfix list into a C function of (x, X, n), one
+ * constant per stack operation, and start compiling it into "p" with
+ * hprog_cc() in the background.
+ * The compiler is left to fold constants and strength-reduce powers.
+ * Once it finishes, hprog_exec() will call into the object instead of
+ * interpreting "p"; on any failure (e.g., no compiler), "p" is left be.
+ * Returns zero if compilation could not be started.
+ */
+int
+hprog_native(struct hprog *p, const struct hnode *const *pp)
+{
+	struct hcc	*cc;
+	GString		*src;
+	size_t		 stack[STACKSZ], ssz, v;
+	const char	*op;
+
+	src = g_string_new("#include <math.h>\n"
+		"double bmigrate_pi(double x, double X, double n);\n"
+		"double\nbmigrate_pi(double x, double X, double n)\n{\n");
+
+	for (v = ssz = 0; NULL != *pp; pp++) {
+		switch ((*pp)->type) {
+		case (HNODE_POSITIVE):
+			continue;
+		case (HNODE_P1):
+			g_string_append_printf(src, 
+				"\tconst double v%zu = x;\n", v);
+			break;
+		case (HNODE_PN):
+			g_string_append_printf(src, 
+				"\tconst double v%zu = X;\n", v);
+			break;
+		case (HNODE_N):
+			g_string_append_printf(src, 
+				"\tconst double v%zu = n;\n", v);
+			break;
+		case (HNODE_NUMBER):
+			/* Hexadecimal so that we lose no precision. */
+			g_string_append_printf(src, 
+				"\tconst double v%zu = %a;\n", 
+				v, (*pp)->real);
+			break;
+		case (HNODE_SQRT):
+			/* FALLTHROUGH */
+		case (HNODE_EXPF):
+			/* FALLTHROUGH */
+		case (HNODE_NEGATIVE):
+			assert(ssz > 0);
+			op = HNODE_SQRT == (*pp)->type ? "sqrt" :
+				HNODE_EXPF == (*pp)->type ? "exp" : "-";
+			g_string_append_printf(src, 
+				"\tconst double v%zu = %s(v%zu);\n", 
+				v, op, stack[--ssz]);
+			break;
+		case (HNODE_EXP):
+			assert(ssz > 1);
+			g_string_append_printf(src, 
+				"\tconst double v%zu = pow(v%zu, v%zu);\n", 
+				v, stack[ssz - 2], stack[ssz - 1]);
+			ssz -= 2;
+			break;
+		default:
+			assert(ssz > 1);
+			op = HNODE_ADD == (*pp)->type ? "+" :
+				HNODE_SUB == (*pp)->type ? "-" :
+				HNODE_MUL == (*pp)->type ? "*" : "/";
+			g_string_append_printf(src, 
+				"\tconst double v%zu = v%zu %s v%zu;\n", 
+				v, stack[ssz - 2], op, stack[ssz - 1]);
+			ssz -= 2;
+			break;
+		}
+		assert(ssz < STACKSZ);
+		stack[ssz++] = v++;
+	}
+
+	assert(1 == ssz);
+	g_string_append_printf(src, "\treturn(v%zu);\n}\n", stack[0]);
+
+	g_assert(NULL == p->cc);
+	cc = g_malloc(sizeof(struct hcc));
+	cc->p = p;
+	cc->src = src;
+	p->cc = g_thread_try_new("cc", hprog_cc, cc, NULL);
+	if (NULL == p->cc) {
+		g_string_free(src, TRUE);
+		g_free(cc);
+		return(0);
+	}
+	return(1);
+}
+
+/*
+ * Execute a compiled expression, natively if we have it.
+ * There are no checks here: the program is correct by construction.
+ */
+double
+hprog_exec(const struct hprog *p, double x, double X, size_t n)
+{
+	double		  rbuf[HREGSZ], *r, v;
+	const struct hins *in, *end;
+	double		(*fn)(double, double, double);
+
+	fn = (double (*)(double, double, double))
+		g_atomic_pointer_get(&p->fn);
+	if (NULL != fn)
+		return(fn(x, X, (double)n));
+
+	r = p->regs <= HREGSZ ? rbuf : 
+		g_malloc(p->regs * sizeof(double));
+	r[HREG_P1] = x;
+	r[HREG_PN] = X;
+	r[HREG_N] = (double)n;
+
+	for (in = p->ins, end = in + p->len; in < end; in++)
+		switch (in->op) {
+		case (HOP_LOADK):
+			r[in->dst] = in->k;
+			break;
+		case (HOP_ADD):
+			r[in->dst] = r[in->a] + r[in->b];
+			break;
+		case (HOP_SUB):
+			r[in->dst] = r[in->a] - r[in->b];
+			break;
+		case (HOP_MUL):
+			r[in->dst] = r[in->a] * r[in->b];
+			break;
+		case (HOP_DIV):
+			r[in->dst] = r[in->a] / r[in->b];
+			break;
+		case (HOP_POW):
+			r[in->dst] = pow(r[in->a], r[in->b]);
+			break;
+		case (HOP_SQRT):
+			r[in->dst] = sqrt(r[in->a]);
+			break;
+		case (HOP_EXPF):
+			r[in->dst] = exp(r[in->a]);
+			break;
+		case (HOP_NEG):
+			r[in->dst] = -r[in->a];
+			break;
+		case (HOP_ADDK):
+			r[in->dst] = r[in->a] + in->k;
+			break;
+		case (HOP_SUBK):
+			r[in->dst] = r[in->a] - in->k;
+			break;
+		case (HOP_RSUBK):
+			r[in->dst] = in->k - r[in->a];
+			break;
+		case (HOP_MULK):
+			r[in->dst] = r[in->a] * in->k;
+			break;
+		case (HOP_DIVK):
+			r[in->dst] = r[in->a] / in->k;
+			break;
+		case (HOP_RDIVK):
+			r[in->dst] = in->k / r[in->a];
+			break;
+		case (HOP_POWK):
+			r[in->dst] = pow(r[in->a], in->k);
+			break;
+		case (HOP_SQ):
+			r[in->dst] = r[in->a] * r[in->a];
+			break;
+		case (HOP_MADD):
+			r[in->dst] = r[in->a] * r[in->b] + r[in->c];
+			break;
+		case (HOP_MSUB):
+			r[in->dst] = r[in->a] * r[in->b] - r[in->c];
+			break;
+		case (HOP_NMADD):
+			r[in->dst] = r[in->c] - r[in->a] * r[in->b];
+			break;
+		default:
+			abort();
+		}
+
+	v = r[p->res];
+	if (r != rbuf)
+		g_free(r);
+	return(v);
+}
+
+/*
+ * Number of points evaluated together by hprog_exec_batch().
+ */
+#define	HBATCH	 16
+
+/*
+ * On x86-64 with ifunc support, also build an AVX2 variant of the
+ * batch evaluator, picked at run-time; the baseline is SSE2.
+ * Resolving ifuncs is up to the C library, and glibc (defined by its
+ * headers, which we've already included) is the one we know does.
+ */
+#if defined(__x86_64__) && defined(__GNUC__) && defined(__GLIBC__)
+#define	HBATCH_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define	HBATCH_CLONES
+#endif
+
+#define	HBATCH_LANES(_v) \
+	for (j = 0; j < HBATCH; j++) \
+		d[j] = (_v)
+
+/*
+ * Evaluate a compiled expression at "count" points at once, writing the
+ * results into "out".
+ * Each instruction is applied to a block of HBATCH points in a loop
+ * the compiler vectorises, so the dispatch is shared by the block.
+ * A short last block is padded: its extra lanes are never written out.
+ * Registers are written once, so destinations never alias operands.
+ */
+HBATCH_CLONES void
+hprog_exec_batch(const struct hprog *p, const double *x, 
+	const double *X, const size_t *n, double *out, size_t count)
+{
+	double		   rbuf[HREGSZ][HBATCH];
+	double		 (*r)[HBATCH];
+	const struct hins *in, *end;
+	double *restrict   d;
+	const double	  *restrict a, *restrict b, *restrict c;
+	size_t		   i, j, len;
+	double		 (*fn)(double, double, double);
+
+	fn = (double (*)(double, double, double))
+		g_atomic_pointer_get(&p->fn);
+	if (NULL != fn) {
+		for (i = 0; i < count; i++)
+			out[i] = fn(x[i], X[i], (double)n[i]);
+		return;
+	}
+
+	r = p->regs <= HREGSZ ? rbuf : 
+		g_malloc(p->regs * sizeof(*r));
+
+	for (i = 0; i < count; i += HBATCH) {
+		len = count - i < HBATCH ? count - i : HBATCH;
+		for (j = 0; j < len; j++) {
+			r[HREG_P1][j] = x[i + j];
+			r[HREG_PN][j] = X[i + j];
+			r[HREG_N][j] = (double)n[i + j];
+		}
+		for ( ; j < HBATCH; j++)
+			r[HREG_P1][j] = r[HREG_PN][j] = r[HREG_N][j] = 1.0;
+
+		for (in = p->ins, end = in + p->len; in < end; in++) {
+			d = r[in->dst];
+			a = r[in->a];
+			b = r[in->b];
+			c = r[in->c];
+			switch (in->op) {
+			case (HOP_LOADK):
+				HBATCH_LANES(in->k);
+				break;
+			case (HOP_ADD):
+				HBATCH_LANES(a[j] + b[j]);
+				break;
+			case (HOP_SUB):
+				HBATCH_LANES(a[j] - b[j]);
+				break;
+			case (HOP_MUL):
+				HBATCH_LANES(a[j] * b[j]);
+				break;
+			case (HOP_DIV):
+				HBATCH_LANES(a[j] / b[j]);
+				break;
+			case (HOP_POW):
+				HBATCH_LANES(pow(a[j], b[j]));
+				break;
+			case (HOP_SQRT):
+				HBATCH_LANES(sqrt(a[j]));
+				break;
+			case (HOP_EXPF):
+				HBATCH_LANES(exp(a[j]));
+				break;
+			case (HOP_NEG):
+				HBATCH_LANES(-a[j]);
+				break;
+			case (HOP_ADDK):
+				HBATCH_LANES(a[j] + in->k);
+				break;
+			case (HOP_SUBK):
+				HBATCH_LANES(a[j] - in->k);
+				break;
+			case (HOP_RSUBK):
+				HBATCH_LANES(in->k - a[j]);
+				break;
+			case (HOP_MULK):
+				HBATCH_LANES(a[j] * in->k);
+				break;
+			case (HOP_DIVK):
+				HBATCH_LANES(a[j] / in->k);
+				break;
+			case (HOP_RDIVK):
+				HBATCH_LANES(in->k / a[j]);
+				break;
+			case (HOP_POWK):
+				HBATCH_LANES(pow(a[j], in->k));
+				break;
+			case (HOP_SQ):
+				HBATCH_LANES(a[j] * a[j]);
+				break;
+			case (HOP_MADD):
+				HBATCH_LANES(a[j] * b[j] + c[j]);
+				break;
+			case (HOP_MSUB):
+				HBATCH_LANES(a[j] * b[j] - c[j]);
+				break;
+			case (HOP_NMADD):
+				HBATCH_LANES(c[j] - a[j] * b[j]);
+				break;
+			default:
+				abort();
+			}
+		}
+
+		memcpy(&out[i], r[p->res], len * sizeof(double));
+	}
+
+	if (r != rbuf)
+		g_free(r);
+}
+
 static void
 hnode_test_expect(double x, double X, 
 	double n, const char *expf, double vexp)
 {
-	struct hnode	 **exp;
-	double		   v;
+	struct hnode	 **exp, **bound;
+	struct hprog	  *prog, *bprog;
+	double		   v, vc, vb;
 	const char	  *expfp;
 
 	expfp = expf;
@@ -592,8 +1542,23 @@ hnode_test_expect(double x, double X,
 	assert(NULL != exp);
 	v = hnode_exec
 		((const struct hnode *const *)exp, x, X, n);
-	g_debug("pi(x=%g, X=%g, n=%g) = %s = %g (want %g)", 
-		x, X, n, expf, v, vexp);
+	prog = hprog_compile
+		((const struct hnode *const *)exp);
+	vc = hprog_exec(prog, x, X, n);
+	bound = hnode_bind
+		((const struct hnode *const *)exp, n);
+	bprog = hprog_compile
+		((const struct hnode *const *)bound);
+	vb = hprog_exec(bprog, x, X, 0);
+	g_debug("pi(x=%g, X=%g, n=%g) = %s = %g, "
+		"compiled %g, bound %g (want %g)", 
+		x, X, n, expf, v, vc, vb, vexp);
+	g_assert(fabs(v - vexp) <= 1e-12 * fabs(vexp));
+	g_assert(fabs(vc - vexp) <= 1e-12 * fabs(vexp));
+	g_assert(fabs(vb - vexp) <= 1e-12 * fabs(vexp));
+	hprog_free(bprog);
+	hprog_free(prog);
+	hnode_free(bound);
 	hnode_free(exp);
 }
 
@@ -617,4 +1582,13 @@ hnode_test(void)
 	hnode_test_expect(x, X, n, 
 		"x * (1 / X) - x",
 		x * (1.0 / X) - x);
+	hnode_test_expect(x, X, n, 
+		"exp(2) * sqrt(4) - -(-x) + +X",
+		exp(2.0) * sqrt(4.0) - x + X);
+	hnode_test_expect(x, X, n, 
+		"(x + X)^3 - (X + x)^4 / x^(-1) + X^1",
+		pow(x + X, 3.0) - pow(X + x, 4.0) / pow(x, -1.0) + X);
+	hnode_test_expect(x, X, n, 
+		"x * X / n^2 + x * X - 2^n^0.5",
+		x * X / pow(n, 2.0) + x * X - pow(2.0, pow(n, 0.5)));
 }
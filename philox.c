@@ -0,0 +1,150 @@
+/*	$Id$ */
+/*
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtk/gtk.h>
+#include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
+#include <gsl/gsl_multifit.h>
+#include <gsl/gsl_histogram.h>
+#include <kplot.h>
+
+#include "extern.h"
+
+/*
+ * The Philox4x32-10 counter-based generator of Salmon et al., "Parallel
+ * Random Numbers: As Easy as 1, 2, 3" (SC '11).
+ * Each output block is a keyed bijection of a 128-bit counter, so any
+ * (key, counter) gives an independent stream without any state to
+ * carry between runs.
+ * We key with the simulation seed and put the stream (the run's ticket)
+ * in the upper half of the counter, the lower half counting blocks.
+ */
+#define	PHILOX_M0	 0xD2511F53U
+#define	PHILOX_M1	 0xCD9E8D57U
+#define	PHILOX_W0	 0x9E3779B9U
+#define	PHILOX_W1	 0xBB67AE85U
+#define	PHILOX_ROUNDS	 10
+
+/*
+ * Blocks generated at once: the loop over them is independent, so the
+ * compiler interleaves (or vectorises) the multiplications.
+ */
+#define	PHILOX_BLOCKS	 8
+
+struct	philox {
+	uint32_t	 key[2];
+	uint64_t	 block; /* next block number */
+	uint64_t	 stream; /* stream number */
+	uint32_t	 out[PHILOX_BLOCKS * 4]; /* buffered outputs */
+	size_t		 pos; /* next in "out" */
+};
+
+static void
+philox_fill(struct philox *p)
+{
+	uint32_t	 c[PHILOX_BLOCKS][4], k0, k1, lo0, lo1;
+	uint64_t	 m0, m1;
+	size_t		 i, r;
+
+	for (i = 0; i < PHILOX_BLOCKS; i++) {
+		c[i][0] = (uint32_t)(p->block + i);
+		c[i][1] = (uint32_t)((p->block + i) >> 32);
+		c[i][2] = (uint32_t)p->stream;
+		c[i][3] = (uint32_t)(p->stream >> 32);
+	}
+
+	k0 = p->key[0];
+	k1 = p->key[1];
+	for (r = 0; r < PHILOX_ROUNDS; r++) {
+		for (i = 0; i < PHILOX_BLOCKS; i++) {
+			m0 = (uint64_t)PHILOX_M0 * c[i][0];
+			m1 = (uint64_t)PHILOX_M1 * c[i][2];
+			lo0 = (uint32_t)m0;
+			lo1 = (uint32_t)m1;
+			c[i][0] = (uint32_t)(m1 >> 32) ^ c[i][1] ^ k0;
+			c[i][2] = (uint32_t)(m0 >> 32) ^ c[i][3] ^ k1;
+			c[i][1] = lo1;
+			c[i][3] = lo0;
+		}
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+
+	memcpy(p->out, c, sizeof(p->out));
+	p->block += PHILOX_BLOCKS;
+	p->pos = 0;
+}
+
+static void
+philox_set(void *arg, unsigned long seed)
+{
+	struct philox	*p = arg;
+
+	memset(p, 0, sizeof(struct philox));
+	p->key[0] = (uint32_t)seed;
+	p->key[1] = (uint32_t)((uint64_t)seed >> 32);
+	p->pos = PHILOX_BLOCKS * 4;
+}
+
+static unsigned long
+philox_get(void *arg)
+{
+	struct philox	*p = arg;
+
+	if (PHILOX_BLOCKS * 4 == p->pos)
+		philox_fill(p);
+	return(p->out[p->pos++]);
+}
+
+static double
+philox_get_double(void *arg)
+{
+
+	return(philox_get(arg) / 4294967296.0);
+}
+
+static const gsl_rng_type philox_type = {
+	"philox4x32-10",
+	0xffffffffUL,
+	0,
+	sizeof(struct philox),
+	philox_set,
+	philox_get,
+	philox_get_double
+};
+
+const gsl_rng_type *rng_philox = &philox_type;
+
+/*
+ * Restart a Philox generator on the given key and stream.
+ */
+void
+rng_philox_stream(gsl_rng *rng, uint64_t seed, uint64_t stream)
+{
+	struct philox	*p = rng->state;
+
+	g_assert(&philox_type == rng->type);
+	p->key[0] = (uint32_t)seed;
+	p->key[1] = (uint32_t)(seed >> 32);
+	p->block = 0;
+	p->stream = stream;
+	p->pos = PHILOX_BLOCKS * 4;
+}
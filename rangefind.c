@@ -25,6 +25,7 @@
 #include <gtk/gtk.h>
 #include <gdk/gdk.h>
 #include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
 #include <gsl/gsl_multifit.h>
 #include <gsl/gsl_histogram.h>
 #include <kplot.h>
@@ -38,63 +39,73 @@
 int
 rangefind(struct bmigrate *b)
 {
-	size_t		 mutants;
-	double		 mstrat, istrat, v;
+	size_t		 mutants, i, len;
+	double		 mstrat, istrat, v, X;
+	double		*xs, *Xs, *vs;
+	size_t		*ns;
 	gchar		 buf[22];
 
 	g_assert(b->rangeid);
 
+	mstrat = b->range.ymin + 
+		(b->range.slicey / (double)b->range.slices) * 
+		(b->range.ymax - b->range.ymin);
+	istrat = b->range.xmin + 
+		(b->range.slicex / (double)b->range.slices) * 
+		(b->range.xmax - b->range.xmin);
+
+	xs = g_malloc_n(2 * b->range.n, sizeof(double));
+	Xs = g_malloc_n(2 * b->range.n, sizeof(double));
+	vs = g_malloc_n(2 * b->range.n, sizeof(double));
+	ns = g_malloc_n(2 * b->range.n, sizeof(size_t));
+
 	/*
 	 * Set the number of mutants on a given island, then see what
 	 * the utility function would yield given that number of mutants
 	 * and incumbents, setting the current player to be one or the
 	 * other..
+	 * Only check for a given mutant/incumbent individual's strategy
+	 * if the population is going to support the existence of that
+	 * individual.
+	 * We lay out all of these in order, evaluate them in one batch,
+	 * then scan them in order.
 	 */
-	mstrat = istrat = 0.0;
-	for (mutants = 0; mutants <= b->range.n; mutants++) {
-		mstrat = b->range.ymin + 
-			(b->range.slicey / (double)b->range.slices) * 
-			(b->range.ymax - b->range.ymin);
-		istrat = b->range.xmin + 
-			(b->range.slicex / (double)b->range.slices) * 
-			(b->range.xmax - b->range.xmin);
-		/*
-		 * Only check for a given mutant/incumbent individual's
-		 * strategy if the population is going to support the
-		 * existence of that individual.
-		 */
+	for (len = mutants = 0; mutants <= b->range.n; mutants++) {
+		X = mstrat * mutants + istrat * (b->range.n - mutants);
 		if (mutants > 0) {
-			v = hnode_exec
-				((const struct hnode *const *) 
-				 b->range.exp, 
-				 istrat, mstrat * mutants + istrat * 
-				 (b->range.n - mutants), b->range.n);
-			if (0.0 != v && ! isnormal(v))
-				break;
-			if (v < b->range.pimin)
-				b->range.pimin = v;
-			if (v > b->range.pimax)
-				b->range.pimax = v;
-			b->range.piaggr += v;
-			b->range.picount++;
+			xs[len] = istrat;
+			Xs[len] = X;
+			ns[len++] = b->range.n;
 		}
 		if (mutants != b->range.n) {
-			v = hnode_exec
-				((const struct hnode *const *) 
-				 b->range.exp, 
-				 mstrat, mstrat * mutants + istrat * 
-				 (b->range.n - mutants), b->range.n);
-			if (0.0 != v && ! isnormal(v))
-				break;
-			if (v < b->range.pimin)
-				b->range.pimin = v;
-			if (v > b->range.pimax)
-				b->range.pimax = v;
-			b->range.piaggr += v;
-			b->range.picount++;
+			xs[len] = mstrat;
+			Xs[len] = X;
+			ns[len++] = b->range.n;
 		}
 	}
 
+	hprog_exec_batch(b->range.prog, xs, Xs, ns, vs, len);
+
+	for (i = 0; i < len; i++) {
+		v = vs[i];
+		if (0.0 != v && ! isnormal(v))
+			break;
+		if (v < b->range.pimin)
+			b->range.pimin = v;
+		if (v > b->range.pimax)
+			b->range.pimax = v;
+		b->range.piaggr += v;
+		b->range.picount++;
+	}
+
+	/* The first point of each count but zero is the incumbent's. */
+	mutants = i < len ? (i + 1) / 2 : b->range.n + 1;
+
+	g_free(xs);
+	g_free(Xs);
+	g_free(vs);
+	g_free(ns);
+
 	/*
 	 * We might have hit a discontinuous number.
 	 * If we did, then print out an error and don't continue.
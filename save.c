@@ -25,6 +25,7 @@
 #include <cairo-ps.h>
 #include <gtk/gtk.h>
 #include <gsl/gsl_multifit.h>
+#include <gsl/gsl_randist.h>
 #include <kplot.h>
 
 #include "extern.h"
@@ -215,6 +216,7 @@ saveconfig(const gchar *fname, const struct curwin *cur)
 			(unsigned int)(cur->b->clrs[sim->colour].rgba[2] * 255));
 		fprintf(f, "Function: %s\n", sim->func);
 		fprintf(f, "Threads: %zu\n", sim->nprocs);
+		fprintf(f, "Seed: %" PRIu64 "\n", sim->seed);
 		fprintf(f, "Multiplier: %g(1 + %g lambda)\n", 
 			sim->alpha, sim->delta);
 		fprintf(f, "Max generations: %zu\n", sim->stop);
@@ -271,6 +273,14 @@ saveconfig(const gchar *fname, const struct curwin *cur)
 			fprintf(f, "Island populations: %zu\n", sim->pop);
 		fprintf(f, "Fit polynomial: %zu (%sweighted)\n",
 			sim->fitpoly, 0 == sim->weighted ? "un" : "");
+		if (ENGINE_EXACT == sim->engine)
+			fprintf(f, "Engine: exact\n");
+		else if (ENGINE_DIFFUSION == sim->engine)
+			fprintf(f, "Engine: diffusion\n");
+		else
+			fprintf(f, "Engine: sampled\n");
+		fprintf(f, "Incumbent sampling: %s\n",
+			NULL == sim->sched ? "uniform" : "adaptive");
 
 		fprintf(f, "\n");
 	}
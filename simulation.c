@@ -18,9 +18,6 @@
 #include <math.h>
 #include <stdint.h>
 #include <stdlib.h>
-#ifdef __linux__
-#include <bsd/stdlib.h> /* arc4random() */
-#endif
 #include <string.h>
 
 #include <gtk/gtk.h>
@@ -31,6 +28,49 @@
 
 #include "extern.h"
 
+/*
+ * Whether islands may die off during a run.
+ */
+#define	SIM_IDEATH(_s) \
+	(NULL != (_s)->pops && (_s)->ideathmean > 0)
+
+/*
+ * Whether islands are exchangeable, so we can simulate with a histogram
+ * of island mutant counts (see hist_run()).
+ */
+#define	SIM_HIST(_s) \
+	(NULL == (_s)->pops && NULL == (_s)->ms && (_s)->islands > 1)
+
+/*
+ * Whether we can simulate only islands with mutants (see frontier_step())
+ * and how sparse they must be for us to do so: at most one island in
+ * SIM_FRONTIER_FRAC.
+ */
+#define	SIM_FRONTIER(_s) \
+	(0 == SIM_IDEATH(_s) && 0 == SIM_HIST(_s) && (_s)->islands > 1)
+#define	SIM_FRONTIER_FRAC 8
+
+/*
+ * Most memory used by shared payoff tables (see payoffs_share()).
+ */
+#define	SIM_PAYOFFS_MAX	(128 * 1024 * 1024)
+
+/*
+ * Largest Poisson mean drawn by inversion (see poisson()), and a bound
+ * on its search in case rounding leaves the cumulative sum below one.
+ */
+#define	SIM_POISSON_INV	 24.0
+#define	SIM_POISSON_KMAX 256
+
+/*
+ * In adaptive schedules (see on_sim_sched()), incumbents within
+ * SIM_SCHED_Z standard errors of the minimum mean share all but one
+ * slot per incumbent, the rest getting one apiece.
+ * We don't adapt until each incumbent has SIM_SCHED_MIN runs.
+ */
+#define	SIM_SCHED_Z	 2.0
+#define	SIM_SCHED_MIN	 16.0
+
 /*
  * For a given point "x" in the domain, fit ourselves to the polynomial
  * coefficients of degree "fitpoly + 1".
@@ -163,60 +203,153 @@ snapshot(struct sim *sim, struct simwarm *warm,
 }
 
 /*
- * In a given simulation, compute the next mutant/incumbent pair.
- * We make sure that incumbents are striped evenly in any given
- * simulation but that mutants are randomly selected from within the
- * strategy domain.
+ * Set the mean and (unbiased) standard deviation of "st" as the "i"th
+ * point.
  */
-static int
-on_sim_next(struct sim *sim, const gsl_rng *rng, 
-	size_t *islandidx, double *mutantp, double *incumbentp, 
-	size_t *incumbentidx, double *vp, const size_t *islands,
-	size_t gen)
+static void
+on_sim_stat(struct kdata *mean, struct kdata *stddev, 
+	size_t i, double x, const struct simstat *st)
 {
-	int		 dosnap, rc;
-	size_t		 mutant;
-	uint64_t	 truns, tgens;
+	int	 rc;
 
-	if (sim->terminate)
-		return(0);
+	rc = kdata_array_set(mean, i, x, st->mean);
+	g_assert(0 != rc);
+	rc = kdata_array_set(stddev, i, x, st->n > 1.0 ? 
+		sqrt(st->m2 / (st->n - 1.0)) : 0.0);
+	g_assert(0 != rc);
+}
 
-	truns = tgens = 0; /* Silence compiler. */
+/*
+ * Compute our statistics from the merged raw results straight into the
+ * "hotlsb" buffers.
+ * This is called by the thread that owns the copyout (copyout is 2), so
+ * needs no lock: the main thread won't merge until it's finished.
+ */
+static void
+on_sim_stats(struct sim *sim)
+{
+	const struct simacc *acc = &sim->acc;
+	struct simstat	 st, fixed, empty;
+	size_t		 i;
+	double		 x, n;
+	int		 rc;
 
-	/* This is set if we "own" the LSB->warm process. */
-	dosnap = 0;
+	for (i = 0; i <= acc->stop; i++) {
+		rc = kdata_array_set(sim->bufs.times->hotlsb, 
+			i, i, acc->times[i]);
+		g_assert(0 != rc);
+	}
 
-	g_assert(*incumbentidx < sim->dims);
-	g_assert(*islandidx < sim->islands);
-	g_mutex_lock(&sim->hot.mux);
+	for (i = 0; i < acc->dims; i++) {
+		x = sim->xmin + (sim->xmax - sim->xmin) * 
+			(i / (double)sim->dims);
+		on_sim_stat(sim->bufs.means->hotlsb, 
+			sim->bufs.stddevs->hotlsb, i, x, &acc->fracs[i]);
+		n = acc->fracs[i].n;
+		rc = kdata_array_set(sim->bufs.mextinct->hotlsb, i, x, 
+			n > 0.0 ? acc->mextinct[i] / n : 0.0);
+		g_assert(0 != rc);
+		rc = kdata_array_set(sim->bufs.iextinct->hotlsb, i, x, 
+			n > 0.0 ? acc->iextinct[i] / n : 0.0);
+		g_assert(0 != rc);
+	}
 
 	/*
-	 * If we're entering this with a result value, then plug it into
-	 * the index associated with the run and increment our count.
-	 * This prevents us from overwriting others' results.
+	 * Island occupancy is averaged over all runs.
+	 * Only runs leaving mutants on an island are in "occupied", so
+	 * we merge in fixated runs (see on_sim_next()) with their full
+	 * island and the remaining runs with none.
 	 */
-	if (NULL != vp) {
-		rc = kdata_array_add
-			(sim->bufs.times->hot, gen, 1.0);
-		g_assert(0 != rc);
-		rc = kdata_array_fill_ysizes
-			(sim->bufs.islands, islands);
-		g_assert(0 != rc);
-		rc = kdata_array_set(sim->bufs.fractions, 
-			*incumbentidx, *incumbentp, *vp);
-		g_assert(0 != rc);
-		rc = kdata_array_set(sim->bufs.ifractions, 
-			*islandidx, *islandidx, *vp);
-		g_assert(0 != rc);
-		rc = kdata_array_set(sim->bufs.mutants, 
-			*incumbentidx, *incumbentp, 0.0 == *vp);
-		g_assert(0 != rc);
-		rc = kdata_array_set(sim->bufs.incumbents, 
-			*incumbentidx, *incumbentp, 1.0 == *vp);
-		g_assert(0 != rc);
-		sim->hot.tgens += gen;
-		sim->hot.truns++;
+	for (i = 0; i < acc->islands; i++) {
+		on_sim_stat(sim->bufs.imeans->hotlsb, 
+			sim->bufs.istddevs->hotlsb, i, i, &acc->ifracs[i]);
+		st = acc->occupied[i];
+		fixed.n = acc->fixed;
+		fixed.mean = NULL != sim->pops ? sim->pops[i] : sim->pop;
+		fixed.m2 = 0.0;
+		empty.n = acc->truns - acc->fixed - st.n;
+		empty.mean = empty.m2 = 0.0;
+		simstat_merge(&st, &fixed);
+		simstat_merge(&st, &empty);
+		on_sim_stat(sim->bufs.islandmeans->hotlsb, 
+			sim->bufs.islandstddevs->hotlsb, i, i, &st);
+	}
+}
+
+/*
+ * Rebuild the adaptive schedule from the merged raw results, handing
+ * most slots to incumbents whose mean mutant fraction can't yet be told
+ * apart from the minimum: those are the only ones that can move the
+ * minimum (see "meanmins").
+ * Each slot is written atomically, as threads read the schedule without
+ * a lock; a run reading a half-built schedule gets a valid incumbent
+ * either way.
+ * Like on_sim_stats(), this is called by the copyout owner.
+ */
+static void
+on_sim_sched(struct sim *sim)
+{
+	const struct simacc *acc = &sim->acc;
+	size_t		 i, j, s, min, nslots, close;
+	double		 se;
+	double		*mus, *ses;
+	int		*in;
+
+	for (i = 0; i < acc->dims; i++)
+		if (acc->fracs[i].n < SIM_SCHED_MIN)
+			return;
+
+	mus = g_malloc_n(acc->dims, sizeof(double));
+	ses = g_malloc_n(acc->dims, sizeof(double));
+	in = g_malloc0_n(acc->dims, sizeof(int));
+
+	for (min = i = 0; i < acc->dims; i++) {
+		mus[i] = acc->fracs[i].mean;
+		ses[i] = sqrt(acc->fracs[i].m2 / 
+			(acc->fracs[i].n - 1.0) / acc->fracs[i].n);
+		if (mus[i] < mus[min])
+			min = i;
+	}
+
+	for (close = i = 0; i < acc->dims; i++) {
+		se = sqrt(ses[i] * ses[i] + ses[min] * ses[min]);
+		in[i] = mus[i] - mus[min] <= SIM_SCHED_Z * se;
+		close += in[i];
 	}
+	g_assert(close > 0);
+
+	/*
+	 * Every incumbent gets one slot; the remainder are split evenly
+	 * among the close ones, cumulatively so they add up.
+	 */
+	nslots = sim->schedsz - acc->dims;
+	for (s = i = j = 0; i < acc->dims; i++) {
+		g_atomic_int_set(&sim->sched[s++], i);
+		if (0 == in[i])
+			continue;
+		j++;
+		while (s < i + 1 + nslots * j / close)
+			g_atomic_int_set(&sim->sched[s++], i);
+	}
+	g_assert(s == sim->schedsz);
+
+	g_free(mus);
+	g_free(ses);
+	g_free(in);
+}
+
+/*
+ * Honour pause and copyout requests from the main thread.
+ */
+static void
+on_sim_sync(struct sim *sim)
+{
+	int		 dosnap;
+
+	/* This is set if we "own" the LSB->warm process. */
+	dosnap = 0;
+
+	g_mutex_lock(&sim->hot.mux);
 
 	/*
 	 * Check if we've been requested to pause.
@@ -228,49 +361,135 @@ on_sim_next(struct sim *sim, const gsl_rng *rng,
 
 	/*
 	 * Check if we've been instructed by the main thread of
-	 * execution to snapshot hot data into warm storage.
+	 * execution to snapshot merged results into warm storage.
 	 * We do this in two parts: first, we register that we're in a
-	 * copyout (it's now 2) and then actually do the copyout outside
-	 * of the hot mutex.
+	 * copyout (it's now 2) and then actually compute and copy out
+	 * our statistics outside of the hot mutex.
 	 */
-	if (1 == sim->hot.copyout) {
-		simbuf_copy_hotlsb(sim->bufs.times);
-		simbuf_copy_hotlsb(sim->bufs.islandmeans);
-		simbuf_copy_hotlsb(sim->bufs.islandstddevs);
-		simbuf_copy_hotlsb(sim->bufs.imeans);
-		simbuf_copy_hotlsb(sim->bufs.istddevs);
-		simbuf_copy_hotlsb(sim->bufs.means);
-		simbuf_copy_hotlsb(sim->bufs.stddevs);
-		simbuf_copy_hotlsb(sim->bufs.mextinct);
-		simbuf_copy_hotlsb(sim->bufs.iextinct);
-		truns = sim->hot.truns;
-		tgens = sim->hot.tgens;
+	if (1 == sim->hot.copyout)
 		sim->hot.copyout = dosnap = 2;
-	} 
+
+	g_mutex_unlock(&sim->hot.mux);
 
 	/*
-	 * Reassign our mutant and incumbent from the ring sized by the
-	 * configured lattice dimensions.
-	 * These both increment in single movements until the end of the
-	 * lattice, then wrap around.
+	 * If we were the ones to set the copyout bit, then do the
+	 * copyout right now.
+	 * When we're finished, lower the copyout semaphor.
 	 */
-	*islandidx = sim->hot.island;
-	mutant = sim->hot.mutant;
-	*incumbentidx = sim->hot.incumbent;
-	sim->hot.mutant++;
-	if (sim->hot.mutant == sim->dims) {
-		sim->hot.incumbent++;
-		if (sim->hot.incumbent == sim->dims) {
-			sim->hot.incumbent = 0;
-			if (MAPINDEX_STRIPED == sim->mapindex)
-				sim->hot.island = 
-					(sim->hot.island + 1) % 
-					sim->islands;
+	if (dosnap) {
+		if (sim->warm.truns != sim->acc.truns) {
+			on_sim_stats(sim);
+			if (NULL != sim->sched)
+				on_sim_sched(sim);
 		}
-		sim->hot.mutant = 0;
+		snapshot(sim, &sim->warm, 
+			sim->acc.truns, sim->acc.tgens);
+		g_mutex_lock(&sim->hot.mux);
+		g_assert(2 == sim->hot.copyout);
+		sim->hot.copyout = 0;
+		g_mutex_unlock(&sim->hot.mux);
 	}
-	
-	g_mutex_unlock(&sim->hot.mux);
+}
+
+/*
+ * In a given simulation, compute the next mutant/incumbent pair.
+ * We make sure that incumbents are striped evenly in any given
+ * simulation but that mutants are randomly selected from within the
+ * strategy domain.
+ * Results go into the thread's own accumulators, which the main thread
+ * merges at copyout, so there's no shared lock per run.
+ * Lattice points are handed out without the lock by atomically taking
+ * a ticket that we decode into our mutant, incumbent, and island.
+ */
+static int
+on_sim_next(struct simthr *thr, gsl_rng *rng, 
+	size_t *islandidx, double *mutantp, double *incumbentp, 
+	size_t *incumbentidx, size_t *mutantidx, double *vp, 
+	const size_t *islands, size_t mutants, size_t gen)
+{
+	struct sim	*sim = thr->sim;
+	struct simacc	*acc = &thr->acc;
+	uint64_t	 ticket;
+	size_t		 i, n, mutant;
+
+	if (sim->terminate)
+		return(0);
+
+	g_assert(*incumbentidx < sim->dims);
+	g_assert(*islandidx < sim->islands);
+
+	/*
+	 * If we're entering this with a result value, then add it to
+	 * our accumulators at the index associated with the run.
+	 */
+	if (NULL != vp) {
+		g_assert(gen <= acc->stop);
+		g_mutex_lock(&acc->mux);
+		acc->times[gen]++;
+		simstat_add(&acc->fracs[*incumbentidx], *vp);
+		if (0.0 == *vp)
+			acc->mextinct[*incumbentidx]++;
+		else if (1.0 == *vp)
+			acc->iextinct[*incumbentidx]++;
+		simstat_add(&acc->ifracs[*islandidx], *vp);
+		/*
+		 * Only visit islands that finished with mutants, and
+		 * stop once we've seen all of them.
+		 * If islands can't die, a fixated run has every island
+		 * full of mutants, so just count it and let
+		 * on_sim_stats() merge them in.
+		 */
+		if (1.0 == *vp && 0 == SIM_IDEATH(sim))
+			acc->fixed++;
+		else
+			for (i = n = 0; n < mutants; i++) {
+				g_assert(i < sim->islands);
+				if (0 == islands[i])
+					continue;
+				n += islands[i];
+				simstat_add(&acc->occupied[i], islands[i]);
+			}
+		acc->tgens += gen;
+		acc->truns++;
+		g_mutex_unlock(&acc->mux);
+	}
+
+	/*
+	 * We peek at pause and copyout requests without the lock: at
+	 * worst, we'll see them after our next run.
+	 */
+	if (1 == g_atomic_int_get(&sim->hot.pause) ||
+	    1 == g_atomic_int_get(&sim->hot.copyout))
+		on_sim_sync(sim);
+
+	/*
+	 * Take our mutant and incumbent from the ring sized by the
+	 * configured lattice dimensions.
+	 * These both increment in single movements until the end of the
+	 * lattice, then wrap around; striped islands increment with
+	 * each full lattice.
+	 * With an adaptive schedule, the incumbent instead comes from
+	 * the schedule slot (see on_sim_sched()).
+	 */
+	ticket = __sync_fetch_and_add(&sim->hot.ticket, 1);
+
+	/*
+	 * The ticket numbers the run, so keying our random numbers with
+	 * it makes the run reproducible regardless of which thread (or
+	 * how many threads) run it.
+	 * (With an adaptive schedule, its incumbent depends on when the
+	 * schedule was last rebuilt, so only its randomness is.)
+	 */
+	rng_philox_stream(rng, sim->seed, ticket);
+
+	*mutantidx = mutant = ticket % sim->dims;
+	ticket /= sim->dims;
+	*incumbentidx = NULL == sim->sched ? ticket % sim->dims :
+		(size_t)g_atomic_int_get
+		(&sim->sched[ticket % sim->schedsz]);
+	ticket /= sim->dims;
+	*islandidx = MAPINDEX_STRIPED == sim->mapindex ?
+		ticket % sim->islands : sim->mapindexfix;
 
 	/*
 	 * Assign our incumbent and mutant.
@@ -295,20 +514,103 @@ on_sim_next(struct sim *sim, const gsl_rng *rng,
 			 sim->xmin) * 
 			(mutant / (double)sim->dims);
 
-	/*
-	 * If we were the ones to set the copyout bit, then do the
-	 * copyout right now.
-	 * When we're finished, lower the copyout semaphor.
-	 */
-	if (dosnap) {
-		snapshot(sim, &sim->warm, truns, tgens);
-		g_mutex_lock(&sim->hot.mux);
-		g_assert(2 == sim->hot.copyout);
-		sim->hot.copyout = 0;
-		g_mutex_unlock(&sim->hot.mux);
+	return(1);
+}
+
+/*
+ * Add the results of a lattice point from a solving engine (exact or
+ * diffusion), as if from a run that fixates with probability "fix"
+ * after "gens" generations.
+ * Sampled runs record the (zero-based) generation they ended in, one
+ * less than the generations they ran, so we do the same, rounded and
+ * clamped to when we'd stop.
+ * Such a run is a sample of the mixture of its outcomes, and is merged
+ * in as such, with the mixture's variance.
+ */
+static void
+on_sim_solved(struct simthr *thr, size_t islandidx, 
+	size_t incumbentidx, double fix, double gens)
+{
+	struct sim	*sim = thr->sim;
+	struct simacc	*acc = &thr->acc;
+	struct simstat	 st;
+	size_t		 i, gen;
+	double		 n;
+
+	gens -= 1.0;
+	if (gens < 0.0)
+		gens = 0.0;
+	gen = gens + 0.5 >= acc->stop ? 
+		acc->stop : (size_t)(gens + 0.5);
+
+	g_mutex_lock(&acc->mux);
+	acc->times[gen]++;
+	st.n = 1.0;
+	st.mean = fix;
+	st.m2 = fix * (1.0 - fix);
+	simstat_merge(&acc->fracs[incumbentidx], &st);
+	simstat_merge(&acc->ifracs[islandidx], &st);
+	acc->mextinct[incumbentidx] += 1.0 - fix;
+	acc->iextinct[incumbentidx] += fix;
+	for (i = 0; i < sim->islands; i++) {
+		n = NULL != sim->pops ? sim->pops[i] : sim->pop;
+		st.mean = fix * n;
+		st.m2 = fix * (1.0 - fix) * n * n;
+		simstat_merge(&acc->occupied[i], &st);
 	}
+	acc->tgens += gen;
+	acc->truns++;
+	g_mutex_unlock(&acc->mux);
+}
 
-	return(1);
+/*
+ * The payoff function to use on an island of size "pop": bound to that
+ * size if we have it.
+ */
+static const struct hprog *
+sim_prog(const struct sim *sim, size_t pop)
+{
+
+	return(pop < sim->progsz && NULL != sim->progs[pop] ?
+		sim->progs[pop] : sim->prog);
+}
+
+/*
+ * The a(1 + delta(v)) function of payoff "v".
+ */
+static double
+fitness(const struct sim *sim, double v)
+{
+
+	g_assert( ! (isnan(v) || isinf(v)));
+	return(sim->alpha * (1.0 + sim->delta * v));
+}
+
+/*
+ * Draw from a Poisson distribution with the given mean, where "emean"
+ * is exp(-mean), cached with the payoffs.
+ * Births are mostly small, so for small means we search the cumulative
+ * distribution from zero with a single uniform, each term following
+ * from the last with one multiplication.
+ * This avoids the exponential and the many uniforms (or the gamma and
+ * binomial variates) of gsl_ran_poisson(), which we use otherwise.
+ */
+static unsigned int
+poisson(const gsl_rng *rng, double mean, double emean)
+{
+	double		 u, p, c;
+	unsigned int	 k;
+
+	if (mean > SIM_POISSON_INV)
+		return(gsl_ran_poisson(rng, mean));
+
+	u = gsl_rng_uniform(rng);
+	p = c = emean;
+	for (k = 0; u >= c && k < SIM_POISSON_KMAX; ) {
+		p *= mean / ++k;
+		c += p;
+	}
+	return(k);
 }
 
 /*
@@ -326,40 +628,906 @@ reproduce(const struct sim *sim, double x,
 	if (0 == pop)
 		return(0.0);
 
-	v = hnode_exec
-		((const struct hnode *const *)
-		 sim->exp, x,
-		 (mutants * mutant) + ((pop - mutants) * incumbent),
-		 pop);
-	g_assert( ! (isnan(v) || isinf(v)));
-	return(sim->alpha * (1.0 + sim->delta * v));
+	v = hprog_exec(sim_prog(sim, pop), x,
+		(mutants * mutant) + ((pop - mutants) * incumbent),
+		pop);
+	return(fitness(sim, v));
+}
+
+/*
+ * Scatter "n" emigrants leaving island "cur" over the other islands,
+ * accumulating their arrivals into "migrants".
+ * Non-uniform migration is handed to the simulation's kernel.
+ * Otherwise, if there are fewer emigrants than destinations, we place
+ * them one by one, skipping over the source island; else we make a
+ * single multinomial draw over uniform weights "probs" less the source.
+ */
+static void
+migrate(const struct sim *sim, const gsl_rng *rng, size_t cur, 
+	unsigned int n, size_t *migrants, unsigned int *counts, 
+	double *probs)
+{
+	size_t	 i, new;
+
+	if (0 == n)
+		return;
+
+	if (NULL != sim->ms) {
+		mkernel_scatter(sim->ms, rng, cur, n, migrants, counts);
+		return;
+	}
+
+	if (n < sim->islands - 1) {
+		while (n-- > 0) {
+			new = gsl_rng_uniform_int
+				(rng, sim->islands - 1);
+			if (new >= cur)
+				new++;
+			migrants[new]++;
+		}
+		return;
+	}
+
+	probs[cur] = 0.0;
+	gsl_ran_multinomial(rng, sim->islands, n, probs, counts);
+	probs[cur] = 1.0;
+
+	g_assert(0 == counts[cur]);
+	for (i = 0; i < sim->islands; i++)
+		migrants[i] += counts[i];
+}
+
+/*
+ * A packed triangular table of payoffs, with one row of "n + 1" entries
+ * for each island size "n" that may occur in the simulation.
+ * Islands of the same size share the same row.
+ * Entries are computed on first use in a run: an entry is only valid
+ * if its stamp matches the table's, which is bumped with each run.
+ * If "shared" is set, it's a complete table (laid out the same way)
+ * shared by all threads, and we use it instead.
+ */
+struct	payoffs {
+	size_t		 max; /* largest island size */
+	size_t		*offs; /* row offset by size (or SIZE_MAX) */
+	size_t		 len; /* number of entries */
+	struct payoff	*vals; /* all rows */
+	uint32_t	*stamps; /* run stamp of each entry */
+	uint32_t	 stamp; /* current run stamp */
+	double		 mutant; /* current mutant strategy */
+	double		 incumbent; /* current incumbent strategy */
+	const struct payoff *shared; /* complete table (or NULL) */
+	double		*xs; /* batch player strategies */
+	double		*Xs; /* batch strategy sums */
+	size_t		*ns; /* batch island sizes */
+	double		*vs; /* batch payoffs */
+};
+
+/*
+ * Lay out the payoff table.
+ * If islands can die, their sizes vary up to their original size, so
+ * we need rows for all sizes up to the largest island.
+ * Otherwise, we only need rows for each distinct island size.
+ */
+static void
+payoffs_alloc(const struct sim *sim, struct payoffs *p)
+{
+	size_t	 i, n, len;
+
+	memset(p, 0, sizeof(struct payoffs));
+
+	if (NULL == sim->pops)
+		p->max = sim->pop;
+	else
+		for (i = 0; i < sim->islands; i++)
+			if (sim->pops[i] > p->max)
+				p->max = sim->pops[i];
+
+	p->offs = g_malloc0_n(p->max + 1, sizeof(size_t));
+	for (n = 0; n <= p->max; n++)
+		p->offs[n] = SIZE_MAX;
+
+	if (NULL == sim->pops)
+		p->offs[sim->pop] = 0;
+	else if (SIM_IDEATH(sim))
+		for (n = 1; n <= p->max; n++)
+			p->offs[n] = 0;
+	else
+		for (i = 0; i < sim->islands; i++)
+			p->offs[sim->pops[i]] = 0;
+
+	for (len = 0, n = 0; n <= p->max; n++) 
+		if (SIZE_MAX != p->offs[n]) {
+			p->offs[n] = len;
+			len += n + 1;
+		}
+
+	p->len = len;
+	p->vals = g_malloc0_n(len, sizeof(struct payoff));
+	p->stamps = g_malloc0_n(len, sizeof(uint32_t));
+
+	if (NULL != sim->ptabs) {
+		p->xs = g_malloc_n(2 * (p->max + 1), sizeof(double));
+		p->Xs = g_malloc_n(2 * (p->max + 1), sizeof(double));
+		p->ns = g_malloc_n(2 * (p->max + 1), sizeof(size_t));
+		p->vs = g_malloc_n(2 * (p->max + 1), sizeof(double));
+	}
 }
 
+/*
+ * Start a run with the given mutant and incumbent strategies.
+ * This invalidates all entries by bumping the run stamp, only clearing
+ * the stamps themselves when they wrap around.
+ */
+static void
+payoffs_reset(struct payoffs *p, double mutant, double incumbent)
+{
+
+	p->mutant = mutant;
+	p->incumbent = incumbent;
+	if (0 == ++p->stamp) {
+		memset(p->stamps, 0, p->len * sizeof(uint32_t));
+		p->stamp = 1;
+	}
+}
+
+/*
+ * Look up the payoffs with "k" mutants on an island of size "n",
+ * computing them if we haven't yet in this run.
+ * Most runs only visit a handful of mutant counts, so this is much
+ * cheaper than computing them all up front.
+ */
+static const struct payoff *
+payoff_get(const struct sim *sim, struct payoffs *p, size_t n, size_t k)
+{
+	size_t		 idx;
+	struct payoff	*pp;
+
+	g_assert(n <= p->max && k <= n);
+	g_assert(SIZE_MAX != p->offs[n]);
+	idx = p->offs[n] + k;
+	if (NULL != p->shared)
+		return(&p->shared[idx]);
+	pp = &p->vals[idx];
+	if (p->stamps[idx] == p->stamp)
+		return(pp);
+
+	pp->m = reproduce(sim, p->mutant, 
+		p->mutant, p->incumbent, k, n);
+	pp->i = reproduce(sim, p->incumbent, 
+		p->mutant, p->incumbent, k, n);
+	pp->em = exp(-pp->m * k);
+	pp->ei = exp(-pp->i * (n - k));
+	p->stamps[idx] = p->stamp;
+	return(pp);
+}
+
+/*
+ * With discrete mutants, the same (incumbent, mutant) lattice pairs come
+ * around again and again, so we keep complete payoff tables for each
+ * pair shared by all threads.
+ * The first thread to need a table builds it and publishes it with an
+ * atomic compare-and-swap; the loser frees its copy.
+ * Published tables are never modified.
+ * We stop building tables once they'd take more than SIM_PAYOFFS_MAX
+ * bytes, falling back to the per-run table.
+ */
+static void
+payoffs_share(struct sim *sim, struct payoffs *p, 
+	size_t incumbentidx, size_t mutantidx)
+{
+	struct payoff	*tab, *pp;
+	gpointer	*slot;
+	size_t		 n, k, sz;
+
+	p->shared = NULL;
+	if (NULL == sim->ptabs)
+		return;
+
+	slot = (gpointer *)&sim->ptabs
+		[incumbentidx * sim->dims + mutantidx];
+	if (NULL != (p->shared = g_atomic_pointer_get(slot)))
+		return;
+
+	/* A racy read, but this is only a soft limit. */
+	sz = p->len * sizeof(struct payoff);
+	if (sim->ptabsz + sz > SIM_PAYOFFS_MAX)
+		return;
+
+	/*
+	 * Evaluate each row in one batch: the mutants' payoffs for all
+	 * mutant counts, then the incumbents'.
+	 */
+	tab = g_malloc_n(p->len, sizeof(struct payoff));
+	for (n = 1; n <= p->max; n++) {
+		if (SIZE_MAX == p->offs[n])
+			continue;
+		for (k = 0; k <= n; k++) {
+			p->xs[k] = p->mutant;
+			p->xs[n + 1 + k] = p->incumbent;
+			p->Xs[k] = p->Xs[n + 1 + k] = 
+				(k * p->mutant) + 
+				((n - k) * p->incumbent);
+			p->ns[k] = p->ns[n + 1 + k] = n;
+		}
+		hprog_exec_batch(sim_prog(sim, n), 
+			p->xs, p->Xs, p->ns, p->vs, 2 * (n + 1));
+		for (k = 0; k <= n; k++) {
+			pp = &tab[p->offs[n] + k];
+			pp->m = fitness(sim, p->vs[k]);
+			pp->i = fitness(sim, p->vs[n + 1 + k]);
+			pp->em = exp(-pp->m * k);
+			pp->ei = exp(-pp->i * (n - k));
+		}
+	}
+
+	if (g_atomic_pointer_compare_and_exchange(slot, NULL, tab)) {
+		__sync_fetch_and_add(&sim->ptabsz, sz);
+		p->shared = tab;
+	} else {
+		g_free(tab);
+		p->shared = g_atomic_pointer_get(slot);
+	}
+}
+
+static void
+payoffs_free(struct payoffs *p)
+{
+
+	g_free(p->offs);
+	g_free(p->vals);
+	g_free(p->stamps);
+	g_free(p->xs);
+	g_free(p->Xs);
+	g_free(p->ns);
+	g_free(p->vs);
+}
+
+/*
+ * If every island is all mutants or all incumbents, nothing can change
+ * until an emigrant lands on an island of the other type: offspring
+ * staying home or landing on islands of their own type can only
+ * replace their own type.
+ * Emigrants are a Poisson thinning of Poisson births, so the arrivals
+ * at each island from each type are independent Poisson variates.
+ * Fill "foreign" and "same" with the mean arrivals at each island from
+ * the other type and from its own (including those staying home), and
+ * "rate" with the sum of "foreign".
+ * The "in" arrays are scratch space for the inflows from mutant and
+ * incumbent islands.
+ * Return zero if any island is mixed.
+ */
+static int
+quiet(const struct sim *sim, struct payoffs *pay, 
+	const size_t *imutants, const size_t *npops, double **in, 
+	double *foreign, double *same, double *rate)
+{
+	const struct payoff *pp;
+	size_t		 i, n;
+	int		 own;
+	double		 mean, tot[2];
+
+	for (i = 0; i < sim->islands; i++) {
+		n = NULL != npops ? npops[i] : sim->pop;
+		if (0 != imutants[i] && n != imutants[i])
+			return(0);
+	}
+
+	tot[0] = tot[1] = 0.0;
+	if (NULL != sim->ms) {
+		memset(in[0], 0, sim->islands * sizeof(double));
+		memset(in[1], 0, sim->islands * sizeof(double));
+	}
+
+	/* Stash each island's mean births in "same" for now. */
+	for (i = 0; i < sim->islands; i++) {
+		n = NULL != npops ? npops[i] : sim->pop;
+		own = 0 == imutants[i];
+		pp = payoff_get(sim, pay, n, imutants[i]);
+		mean = (own ? pp->i : pp->m) * n;
+		same[i] = mean;
+		tot[own] += mean;
+		if (NULL != sim->ms)
+			mkernel_spread(sim->ms, i, 
+				sim->m * mean, in[own]);
+	}
+
+	*rate = 0.0;
+	for (i = 0; i < sim->islands; i++) {
+		own = 0 == imutants[i];
+		mean = same[i];
+		if (NULL != sim->ms) {
+			foreign[i] = in[! own][i];
+			same[i] = in[own][i];
+		} else if (sim->islands > 1) {
+			foreign[i] = sim->m * tot[! own] / 
+				(sim->islands - 1);
+			same[i] = sim->m * (tot[own] - mean) / 
+				(sim->islands - 1);
+		} else
+			foreign[i] = same[i] = 0.0;
+		same[i] += (1.0 - sim->m) * mean;
+		*rate += foreign[i];
+	}
+
+	return(1);
+}
+
+/*
+ * Simulate the generation, following quiet(), in which at least one
+ * emigrant lands on an island of the other type.
+ * The number of such landings is Poisson conditioned to be non-zero,
+ * spread over the islands in proportion to their means.
+ * Each island receiving any replaces one of its own (all of the same
+ * type) with a random arrival, as in a full generation.
+ * All other islands are unchanged.
+ */
+static void
+event(const struct sim *sim, const gsl_rng *rng, double rate, 
+	const double *foreign, const double *same, 
+	const size_t *npops, size_t *imutants, unsigned int *counts, 
+	size_t *mutants, size_t *incumbents)
+{
+	unsigned int	 c, k;
+	size_t		 i, n;
+	double		 u, p, cum;
+
+	if (rate > SIM_POISSON_INV) {
+		do
+			c = gsl_ran_poisson(rng, rate);
+		while (0 == c);
+	} else {
+		u = gsl_rng_uniform(rng);
+		p = cum = rate / expm1(rate);
+		for (c = 1; u >= cum && c < SIM_POISSON_KMAX; ) {
+			p *= rate / ++c;
+			cum += p;
+		}
+	}
+
+	gsl_ran_multinomial(rng, sim->islands, c, foreign, counts);
+
+	for (i = 0; i < sim->islands; i++) {
+		if (0 == counts[i])
+			continue;
+		k = poisson(rng, same[i], exp(-same[i]));
+		if (gsl_rng_uniform_int(rng, counts[i] + k) >= counts[i])
+			continue;
+		n = NULL != npops ? npops[i] : sim->pop;
+		if (n == imutants[i]) {
+			imutants[i]--;
+			(*mutants)--;
+			(*incumbents)++;
+		} else {
+			imutants[i]++;
+			(*mutants)++;
+			(*incumbents)--;
+		}
+	}
+}
+
+/*
+ * The probabilities that an island with "k" mutants loses or gains one
+ * in a generation of hist_run(), given the total mean births of each
+ * type and the migration rate "w" to each other island.
+ */
+static void
+hist_probs(const struct sim *sim, struct payoffs *pay, size_t k,
+	double w, double tm, double ti, double *pdown, double *pup)
+{
+	const struct payoff *pp;
+	size_t		 n = sim->pop;
+	double		 mm, mi, a, b, pany;
+
+	pp = payoff_get(sim, pay, n, k);
+	mm = pp->m * k;
+	mi = pp->i * (n - k);
+	a = (1.0 - sim->m) * mm + w * (tm - mm);
+	b = (1.0 - sim->m) * mi + w * (ti - mi);
+	if (a + b <= 0.0) {
+		*pdown = *pup = 0.0;
+		return;
+	}
+	pany = -expm1(-(a + b));
+	*pdown = pany * b / (a + b) * k / n;
+	*pup = pany * a / (a + b) * (n - k) / n;
+}
+
+/*
+ * Draw how many of "n" islands, each changing with probability "p",
+ * change given that at least one does.
+ * The first to change is the j-th with probability proportional to
+ * (1 - p)^(j - 1) p, which we invert; the rest are unconstrained.
+ */
+static unsigned int
+hist_some(const gsl_rng *rng, double p, unsigned int n)
+{
+	double		 lq, j;
+
+	lq = log1p(-p);
+	j = ceil(log1p(gsl_rng_uniform(rng) * expm1(n * lq)) / lq);
+	if ( ! (j >= 1.0))
+		j = 1.0;
+	else if (j > n)
+		j = n;
+	return(1 + gsl_ran_binomial(rng, p, n - (unsigned int)j));
+}
+
+/*
+ * With uniform island sizes and uniform migration, islands are
+ * exchangeable: all that matters is how many islands have each number
+ * of mutants, so we keep "hist", islands by mutant count, instead of a
+ * count for each island.
+ * We only keep the island the mutant started on apart, with "*tag"
+ * mutants, so that per-island statistics still see it.
+ * Given the state, the arrivals at an island from each type are
+ * independent Poisson variates (see quiet()) with means "a" and "b"
+ * depending only on its mutant count and the population totals.
+ * An island with any arrivals replaces a random islander with a random
+ * arrival, which is a mutant with probability a / (a + b).
+ * So each island with k mutants independently gains or loses one with
+ * probabilities depending only on k, and we draw how many in each class
+ * do so: the cost is in mutant counts, not islands.
+ * The "moves" array is scratch space for these, losses then gains.
+ * When every island is all mutants or all incumbents, as after most
+ * migrations at low rates, only the two pure classes can change, so
+ * we skip ahead to the next generation where any island does, as with
+ * quiet() and event().
+ * Return the generation we stopped at, as for a full simulation.
+ */
 static size_t
-migrate(const struct sim *sim, const gsl_rng *rng, size_t cur)
+hist_run(const struct sim *sim, const gsl_rng *rng,
+	struct payoffs *pay, size_t *hist, unsigned int *moves,
+	size_t *tag, size_t *mutants)
 {
-	double	 v;
-	size_t	 i;
+	const struct payoff *pp;
+	size_t		 t, k, c, n = sim->pop;
+	double		 w, tm, ti, pdown, pup, u, skip, rest;
+	double		 p[3], lq[3];
+	unsigned int	 x[3], g, sz[3];
+	int		 tagmove, need;
 
-again:
-	while (0.0 == (v = gsl_rng_uniform(rng)))
-		/* Loop. */ ;
+	g_assert(sim->islands > 1);
+	w = sim->m / (sim->islands - 1);
+
+	for (t = 0; t < sim->stop; t++) {
+		/*
+		 * If monomorphic, the pure incumbent islands (then the
+		 * pure mutant islands, then the tagged one) each gain
+		 * (lose) a mutant independently with "p": the first
+		 * generation where any does is geometric.
+		 * Draw which do given that at least one does, group by
+		 * group, each given that none before it did.
+		 */
+		if (hist[0] + hist[n] == sim->islands - 1 &&
+		    (0 == *tag || n == *tag)) {
+			tm = (hist[n] + (n == *tag)) * 
+				payoff_get(sim, pay, n, n)->m * n;
+			ti = (hist[0] + (0 == *tag)) * 
+				payoff_get(sim, pay, n, 0)->i * n;
+			hist_probs(sim, pay, 0, w, tm, ti, &pdown, &p[0]);
+			hist_probs(sim, pay, n, w, tm, ti, &p[1], &pup);
+			p[2] = 0 == *tag ? p[0] : p[1];
+			sz[0] = hist[0];
+			sz[1] = hist[n];
+			sz[2] = 1;
+			for (rest = 0.0, g = 0; g < 3; g++) {
+				lq[g] = 0 == sz[g] ? 0.0 :
+					sz[g] * log1p(-p[g]);
+				rest += lq[g];
+			}
+			skip = 0.0 == rest ? sim->stop :
+				floor(gsl_ran_exponential
+				 (rng, 1.0) / -rest);
+			if (skip >= sim->stop - t) {
+				t = sim->stop;
+				break;
+			}
+			t += skip;
+			for (need = 1, g = 0; g < 3; g++) {
+				x[g] = 0;
+				if ( ! need)
+					x[g] = gsl_ran_binomial
+						(rng, p[g], sz[g]);
+				else if (gsl_rng_uniform(rng) * 
+				    -expm1(rest) < -expm1(lq[g])) {
+					x[g] = hist_some(rng, p[g], sz[g]);
+					need = 0;
+				}
+				rest -= lq[g];
+			}
+			hist[0] -= x[0];
+			hist[n] -= x[1];
+			hist[1] += x[0];
+			hist[n - 1] += x[1];
+			*mutants += x[0];
+			*mutants -= x[1];
+			if (x[2] && 0 == *tag) {
+				*tag = 1;
+				(*mutants)++;
+			} else if (x[2]) {
+				*tag = n - 1;
+				(*mutants)--;
+			}
+			if (0 == *mutants || sim->totalpop == *mutants)
+				break;
+			continue;
+		}
+
+		/* Total mean births of each type. */
+		tm = ti = 0.0;
+		for (k = 0; k <= n; k++) {
+			if (0 == (c = hist[k] + (k == *tag)))
+				continue;
+			pp = payoff_get(sim, pay, n, k);
+			tm += c * pp->m * k;
+			ti += c * pp->i * (n - k);
+		}
+
+		tagmove = 0;
+		for (k = 0; k <= n; k++) {
+			moves[2 * k] = moves[2 * k + 1] = 0;
+			if (0 == hist[k] && k != *tag)
+				continue;
+			hist_probs(sim, pay, k, w, tm, ti, &pdown, &pup);
+			if (pdown + pup <= 0.0)
+				continue;
+			if (hist[k] > 0) {
+				moves[2 * k] = gsl_ran_binomial
+					(rng, pdown, hist[k]);
+				u = pdown < 1.0 ? pup / (1.0 - pdown) : 0.0;
+				moves[2 * k + 1] = gsl_ran_binomial
+					(rng, u > 1.0 ? 1.0 : u,
+					 hist[k] - moves[2 * k]);
+			}
+			if (k == *tag) {
+				u = gsl_rng_uniform(rng);
+				tagmove = u < pdown ? -1 :
+					u < pdown + pup ? 1 : 0;
+			}
+		}
+
+		/* Apply the moves once they're all drawn. */
+		for (k = 0; k <= n; k++)
+			hist[k] -= moves[2 * k] + moves[2 * k + 1];
+		for (k = 0; k <= n; k++) {
+			if (k > 0)
+				hist[k - 1] += moves[2 * k];
+			if (k < n)
+				hist[k + 1] += moves[2 * k + 1];
+			*mutants += moves[2 * k + 1];
+			*mutants -= moves[2 * k];
+		}
+		*tag += tagmove;
+		*mutants += tagmove;
 
-	for (i = 0; i < sim->islands - 1; i++)
-		if ((v -= sim->ms[cur][i]) <= 0.0)
+		/* Stop when a population goes extinct. */
+		if (0 == *mutants || sim->totalpop == *mutants)
 			break;
+	}
+
+	return(t);
+}
+
+/*
+ * Expand a histogram state from hist_run() into per-island counts for
+ * on_sim_next(), giving the tagged island its own count and scattering
+ * the others at random (they're exchangeable).
+ */
+static void
+hist_scatter(const struct sim *sim, const gsl_rng *rng,
+	const size_t *hist, size_t tag, size_t islandidx,
+	size_t *imutants)
+{
+	size_t	 i, j, k;
+
+	for (i = k = 0; k <= sim->pop; k++)
+		for (j = 0; j < hist[k]; j++)
+			imutants[i++] = k;
+	g_assert(i == sim->islands - 1);
+	gsl_ran_shuffle(rng, imutants, i, sizeof(size_t));
+	memmove(&imutants[islandidx + 1], &imutants[islandidx],
+		(i - islandidx) * sizeof(size_t));
+	imutants[islandidx] = tag;
+}
+
+/*
+ * Islands with mutants, the "frontier", when few islands have any.
+ * All-incumbent islands only matter to the frontier (and to islands
+ * receiving mutant migrants) through their incumbent emigrants, whose
+ * arrivals at each island are independent Poisson variates, so we only
+ * keep their mean inflow to each island, which depends only on the
+ * incumbent strategy.
+ */
+struct	frontier {
+	size_t		*isles; /* frontier, then islands touched */
+	size_t		 len; /* length of frontier */
+	unsigned char	*mark; /* whether in "isles" */
+	double		*pure; /* kernel: inflow from all islands */
+	double		*sub; /* kernel: inflow from frontier */
+	double		*wts; /* dense kernel: frontier emigrant births */
+	double		 total; /* uniform: births on all islands */
+	double		 front; /* uniform: births on frontier */
+	double		 incumbent; /* strategy of "pure" or "total" */
+	int		 valid; /* whether "pure" or "total" is set */
+};
+
+static void
+frontier_alloc(const struct sim *sim, struct frontier *f)
+{
+
+	memset(f, 0, sizeof(struct frontier));
+	f->isles = g_malloc0_n(sim->islands, sizeof(size_t));
+	f->mark = g_malloc0_n(sim->islands, 1);
+	if (NULL != sim->ms) {
+		f->pure = g_malloc0_n(sim->islands, sizeof(double));
+		if (MKERNEL_DENSE == sim->ms->type)
+			f->wts = g_malloc0_n
+				(sim->islands, sizeof(double));
+		else
+			f->sub = g_malloc0_n
+				(sim->islands, sizeof(double));
+	}
+}
+
+static void
+frontier_free(struct frontier *f)
+{
+
+	g_free(f->isles);
+	g_free(f->mark);
+	g_free(f->pure);
+	g_free(f->sub);
+	g_free(f->wts);
+}
+
+/*
+ * Mean births on island "i" were it all incumbents.
+ */
+static double
+frontier_mean(const struct sim *sim, struct payoffs *pay, size_t i)
+{
+	size_t	 n;
+
+	n = NULL != sim->pops ? sim->pops[i] : sim->pop;
+	return(n * payoff_get(sim, pay, n, 0)->i);
+}
+
+/*
+ * Find the frontier from scratch.
+ * Also compute the inflows from all-incumbent islands if the incumbent
+ * strategy has changed since we last did.
+ */
+static void
+frontier_scan(const struct sim *sim, struct frontier *f,
+	struct payoffs *pay, const size_t *imutants)
+{
+	size_t	 i;
+
+	if ( ! f->valid || f->incumbent != pay->incumbent) {
+		f->total = 0.0;
+		if (NULL != sim->ms)
+			memset(f->pure, 0, sim->islands * sizeof(double));
+		for (i = 0; i < sim->islands; i++)
+			if (NULL != sim->ms)
+				mkernel_spread(sim->ms, i, sim->m * 
+					frontier_mean(sim, pay, i), f->pure);
+			else
+				f->total += frontier_mean(sim, pay, i);
+		f->incumbent = pay->incumbent;
+		f->valid = 1;
+	}
+
+	f->front = 0.0;
+	for (f->len = i = 0; i < sim->islands; i++)
+		if (imutants[i] > 0) {
+			f->isles[f->len++] = i;
+			if (NULL == sim->ms)
+				f->front += frontier_mean(sim, pay, i);
+		}
+}
+
+/*
+ * Whether every frontier island is all mutants, so that every island is
+ * all one type (see quiet()).
+ */
+static int
+frontier_full(const struct sim *sim, const struct frontier *f,
+	const size_t *imutants)
+{
+	size_t	 k, i;
+
+	for (k = 0; k < f->len; k++) {
+		i = f->isles[k];
+		if (imutants[i] != 
+		    (NULL != sim->pops ? sim->pops[i] : sim->pop))
+			return(0);
+	}
+	return(1);
+}
+
+/*
+ * Draw the destination of a migrant leaving island "i".
+ */
+static size_t
+frontier_dest(const struct sim *sim, const gsl_rng *rng, size_t i)
+{
+	size_t	 j;
+
+	if (NULL != sim->ms)
+		return(mkernel_draw(sim->ms, rng, i));
+	j = gsl_rng_uniform_int(rng, sim->islands - 1);
+	return(j >= i ? j + 1 : j);
+}
+
+/*
+ * Simulate a generation on the frontier alone, which must be current.
+ * Frontier islands give birth and migrate as usual, but their incumbent
+ * emigrants only count where they land on an island that matters: one
+ * on the frontier or one that mutant emigrants landed on.
+ * These islands then also receive incumbents from all-incumbent islands
+ * (and, if not on the frontier, their own stayers) in one Poisson draw.
+ * Incumbents landing anywhere else replace incumbents, changing nothing.
+ * The "kids" arrays are scratch space.
+ */
+static void
+frontier_step(const struct sim *sim, const gsl_rng *rng,
+	struct frontier *f, struct payoffs *pay, size_t *imutants,
+	size_t **kids, size_t **migrants, 
+	size_t *mutants, size_t *incumbents)
+{
+	const struct payoff *pp;
+	size_t		 i, j, k, n, len, len1, len2;
+	unsigned int	 e;
+	double		 mean;
+	int		 mutant_old, mutant_new;
+
+	len = f->len;
+	for (k = 0; k < len; k++)
+		f->mark[f->isles[k]] = 1;
+
+	/* Births, and where mutant emigrants land. */
+	for (k = 0; k < f->len; k++) {
+		i = f->isles[k];
+		n = NULL != sim->pops ? sim->pops[i] : sim->pop;
+		pp = payoff_get(sim, pay, n, imutants[i]);
+		kids[0][i] = poisson(rng, 
+			pp->m * imutants[i], pp->em);
+		kids[1][i] = imutants[i] == n ? 0 :
+			poisson(rng, pp->i * (n - imutants[i]), pp->ei);
+		e = gsl_ran_binomial(rng, sim->m, kids[0][i]);
+		migrants[0][i] += kids[0][i] - e;
+		while (e-- > 0) {
+			j = frontier_dest(sim, rng, i);
+			migrants[0][j]++;
+			if (0 == f->mark[j]) {
+				f->mark[j] = 1;
+				f->isles[len++] = j;
+			}
+		}
+		kids[0][i] = 0;
+	}
+
+	/* Incumbent emigrants, now we know which islands matter. */
+	for (k = 0; k < f->len; k++) {
+		i = f->isles[k];
+		e = gsl_ran_binomial(rng, sim->m, kids[1][i]);
+		migrants[1][i] += kids[1][i] - e;
+		while (e-- > 0) {
+			j = frontier_dest(sim, rng, i);
+			if (f->mark[j])
+				migrants[1][j]++;
+		}
+		kids[1][i] = 0;
+	}
 
 	/*
-	 * This can occur due to floating-point rounding.
-	 * If it does, re-run the algorithm.
+	 * Inflow from all-incumbent islands.
+	 * Spreading a dense row costs every island, so for dense kernels
+	 * we take the frontier's share only at the islands that matter.
 	 */
-	if (i == sim->islands - 1 && i == cur) {
-		g_debug("Degenerate probability: re-running");
-		goto again;
+	if (NULL != f->wts)
+		for (k = 0; k < f->len; k++)
+			f->wts[k] = sim->m * 
+				frontier_mean(sim, pay, f->isles[k]);
+	else if (NULL != sim->ms)
+		for (k = 0; k < f->len; k++) {
+			i = f->isles[k];
+			mkernel_spread(sim->ms, i, sim->m * 
+				frontier_mean(sim, pay, i), f->sub);
+		}
+
+	for (k = 0; k < len; k++) {
+		j = f->isles[k];
+		if (NULL != f->wts) {
+			mean = f->pure[j];
+			for (i = 0; i < f->len; i++)
+				mean -= f->wts[i] * mkernel_prob
+					(sim->ms, f->isles[i], j);
+		} else if (NULL != sim->ms)
+			mean = f->pure[j] - f->sub[j];
+		else if (k < f->len)
+			mean = sim->m * (f->total - f->front) / 
+				(sim->islands - 1);
+		else
+			mean = sim->m * (f->total - f->front - 
+				frontier_mean(sim, pay, j)) / 
+				(sim->islands - 1);
+		if (k >= f->len)
+			mean += (1.0 - sim->m) * 
+				frontier_mean(sim, pay, j);
+		if (mean > 0.0)
+			migrants[1][j] += poisson(rng, mean, exp(-mean));
 	}
 
-	g_assert(cur != i);
-	return(i);
+	if (NULL != sim->ms && NULL == f->wts)
+		for (k = 0; k < f->len; k++)
+			mkernel_zero(sim->ms, f->isles[k], f->sub);
+
+	/* Replacement, as in a full generation. */
+	for (k = 0; k < len; k++) {
+		j = f->isles[k];
+		f->mark[j] = 0;
+		len1 = migrants[0][j] + migrants[1][j];
+		if (0 == len1)
+			continue;
+		n = NULL != sim->pops ? sim->pops[j] : sim->pop;
+		len2 = gsl_rng_uniform_int(rng, n);
+		mutant_old = len2 < imutants[j];
+		len2 = gsl_rng_uniform_int(rng, len1);
+		mutant_new = len2 < migrants[0][j];
+		if (mutant_old && ! mutant_new) {
+			imutants[j]--;
+			(*mutants)--;
+			(*incumbents)++;
+		} else if ( ! mutant_old && mutant_new) {
+			imutants[j]++;
+			(*mutants)++;
+			(*incumbents)--;
+		} 
+		migrants[0][j] = migrants[1][j] = 0;
+	}
+
+	/* The new frontier, keeping order. */
+	f->front = 0.0;
+	for (f->len = k = 0; k < len; k++) {
+		j = f->isles[k];
+		if (0 == imutants[j])
+			continue;
+		f->isles[f->len++] = j;
+		if (NULL == sim->ms)
+			f->front += frontier_mean(sim, pay, j);
+	}
+}
+
+/*
+ * An island's next death check, kept in a binary min-heap on "gen".
+ */
+struct	ideath {
+	size_t	 gen; /* generation of the check */
+	size_t	 island;
+	int	 dead; /* waiting to be repopulated */
+};
+
+/*
+ * Move the entry at "i" down the heap of "len" entries until neither
+ * child is due sooner.
+ */
+static void
+ideath_sift(struct ideath *h, size_t len, size_t i)
+{
+	struct ideath	 e;
+	size_t		 c;
+
+	e = h[i];
+	while ((c = 2 * i + 1) < len) {
+		if (c + 1 < len && h[c + 1].gen < h[c].gen)
+			c++;
+		if (e.gen <= h[c].gen)
+			break;
+		h[i] = h[c];
+		i = c;
+	}
+	h[i] = e;
 }
 
 /*
@@ -371,106 +1539,133 @@ simulation(void *arg)
 {
 	struct simthr	  *thr = arg;
 	struct sim	  *sim = thr->sim;
-	double		   mutant, incumbent, v, lambda, prob;
-	unsigned int	   offs;
-	unsigned long	   seed;
-	double		  *vp, *icache, *mcache;
-	double		***icaches, ***mcaches;
+	double		   mutant, incumbent, v, lambda, prob, rate, skip;
+	double		  *in[2], *foreign, *same;
+	unsigned int	  *counts, *moves;
+	double		  *vp, *probs;
+	struct payoffs	   pay;
+	struct frontier	   front, *fp;
+	struct ideath	  *ideaths;
+	struct exact	  *ex;
+	struct diffusion  *dif;
+	const struct payoff *pp, **rows;
 	size_t		  *kids[2], *migrants[2], *imutants, *npops,
-			  *ndeaths;
-	size_t		   t, i, j, k, new, mutants, incumbents,
-			   len1, len2, incumbentidx, islandidx,
-			   ntotalpop;
-	int		   mutant_old, mutant_new;
+			  *hist;
+	size_t		   t, i, j, k, n, mutants, incumbents,
+			   len1, len2, incumbentidx, islandidx, mutantidx,
+			   ntotalpop, tag;
+	int		   mutant_old, mutant_new, exvalid, exfailed;
+	double		   exmutant, exincumbent, exfix, extime;
 	gsl_rng		  *rng;
 
-	rng = gsl_rng_alloc(gsl_rng_default);
-	seed = arc4random();
-	gsl_rng_set(rng, seed);
+	/* Keyed for each run in on_sim_next(). */
+	rng = gsl_rng_alloc(rng_philox);
 
 	g_debug("%p: Thread (simulation %p) "
 		"start", g_thread_self(), sim);
 
-	icache = mcache = NULL;
-	icaches = mcaches = NULL;
 	kids[0] = g_malloc0_n(sim->islands, sizeof(size_t));
 	kids[1] = g_malloc0_n(sim->islands, sizeof(size_t));
-	ndeaths = g_malloc0_n(sim->islands, sizeof(size_t));
 	migrants[0] = g_malloc0_n(sim->islands, sizeof(size_t));
 	migrants[1] = g_malloc0_n(sim->islands, sizeof(size_t));
 	imutants = g_malloc0_n(sim->islands, sizeof(size_t));
+	counts = g_malloc0_n(sim->islands, sizeof(unsigned int));
+	in[0] = g_malloc0_n(sim->islands, sizeof(double));
+	in[1] = g_malloc0_n(sim->islands, sizeof(double));
+	foreign = g_malloc0_n(sim->islands, sizeof(double));
+	same = g_malloc0_n(sim->islands, sizeof(double));
+	ex = NULL;
+	rows = NULL;
+	exvalid = exfailed = 0;
+	exmutant = exincumbent = exfix = extime = 0.0;
+	if (ENGINE_EXACT == sim->engine) {
+		ex = exact_alloc(sim);
+		rows = g_malloc0_n(sim->islands, 
+			sizeof(struct payoff *));
+	}
+	dif = NULL;
+	if (ENGINE_DIFFUSION == sim->engine)
+		dif = diffusion_alloc(sim);
+	fp = NULL;
+	if (ENGINE_SAMPLE == sim->engine && SIM_FRONTIER(sim)) {
+		fp = &front;
+		frontier_alloc(sim, fp);
+	}
+	ideaths = NULL;
+	if (SIM_IDEATH(sim))
+		ideaths = g_malloc0_n(sim->islands, 
+			sizeof(struct ideath));
+	hist = NULL;
+	moves = NULL;
+	if (SIM_HIST(sim)) {
+		hist = g_malloc0_n(sim->pop + 1, sizeof(size_t));
+		moves = g_malloc0_n(2 * (sim->pop + 1), 
+			sizeof(unsigned int));
+	}
+	probs = NULL;
+	if (NULL == sim->ms) {
+		probs = g_malloc0_n(sim->islands, sizeof(double));
+		for (i = 0; i < sim->islands; i++)
+			probs[i] = 1.0;
+	}
 	vp = NULL;
 	npops = NULL;
-	incumbentidx = 0;
+	incumbentidx = mutantidx = 0;
 	islandidx = MAPINDEX_FIXED == sim->mapindex ? 
 		sim->mapindexfix : 0;
 	mutant = incumbent = 0.0;
-	t = 0;
+	t = mutants = 0;
 
 	/*
-	 * Set up our mutant and incumbent payoff caches.
-	 * These consist of all possible payoffs with a given number of
-	 * mutants and incumbents on an island.
-	 * We have two ways of doing this: with non-uniform island sizes
-	 * (icaches and mcaches) and uniform sizes (icache and mcache,
-	 * notice the singular).
-	 * The non-uniform island size can also change, so we precompute
-	 * for all possible populations as well.
+	 * Set up our mutant and incumbent payoff table.
+	 * This consists of all possible payoffs with a given number of
+	 * mutants on an island of a given size.
+	 * The non-uniform island size can also change, so we keep our
+	 * own copy of each island's current population.
 	 */
+	payoffs_alloc(sim, &pay);
 	if (NULL != sim->pops) {
 		g_assert(0 == sim->pop);
 		npops = g_malloc0_n(sim->islands, sizeof(size_t));
 		for (i = 0; i < sim->islands; i++) 
 			npops[i] = sim->pops[i];
-		icaches = g_malloc0_n(sim->islands, sizeof(double **));
-		mcaches = g_malloc0_n(sim->islands, sizeof(double **));
-		for (i = 0; i < sim->islands; i++) {
-			icaches[i] = g_malloc0_n
-				(sim->pops[i] + 1, sizeof(double *));
-			mcaches[i] = g_malloc0_n
-				(sim->pops[i] + 1, sizeof(double *));
-			for (j = 0; j <= sim->pops[i]; j++) {
-				icaches[i][j] = g_malloc0_n(j + 1, sizeof(double));
-				mcaches[i][j] = g_malloc0_n(j + 1, sizeof(double));
-			}
-		}
-	} else {
+	} else
 		g_assert(sim->pop > 0);
-		icache = g_malloc0_n(sim->pop + 1, sizeof(double));
-		mcache = g_malloc0_n(sim->pop + 1, sizeof(double));
-	}
 again:
 	/* 
 	 * Repeat til we're instructed to terminate. 
 	 * We also pass in our last result for processing.
 	 */
-	if ( ! on_sim_next(sim, rng, &islandidx, &mutant, 
-		&incumbent, &incumbentidx, vp, imutants, t)) {
+	if ( ! on_sim_next(thr, rng, &islandidx, &mutant, &incumbent, 
+		&incumbentidx, &mutantidx, vp, imutants, mutants, t)) {
 		g_debug("%p: Thread (simulation %p) exiting", 
 			g_thread_self(), sim);
 		/*
 		 * Upon termination, free up all of the memory
 		 * associated with our simulation.
 		 */
-		g_free(ndeaths);
+		g_free(ideaths);
+		g_free(rows);
+		exact_free(ex);
+		diffusion_free(dif);
+		if (NULL != fp)
+			frontier_free(fp);
 		g_free(imutants);
 		g_free(kids[0]);
 		g_free(kids[1]);
 		g_free(migrants[0]);
 		g_free(migrants[1]);
-		if (NULL != sim->pops)
-			for (i = 0; i < sim->islands; i++) {
-				for (j = 0; j <= sim->pops[i]; j++) {
-					g_free(icaches[i][j]);
-					g_free(mcaches[i][j]);
-				}
-				g_free(icaches[i]);
-				g_free(mcaches[i]);
-			}
-		g_free(icaches);
-		g_free(mcaches);
-		g_free(icache);
-		g_free(mcache);
+		g_free(counts);
+		g_free(in[0]);
+		g_free(in[1]);
+		g_free(foreign);
+		g_free(same);
+		g_free(probs);
+		g_free(npops);
+		g_free(hist);
+		g_free(moves);
+		payoffs_free(&pay);
+		gsl_rng_free(rng);
 		return(NULL);
 	}
 
@@ -484,89 +1679,192 @@ again:
 	incumbents = sim->totalpop - mutants;
 	ntotalpop = sim->totalpop;
 
+	/* Islands killed off in our last run start afresh. */
+	if (NULL != sim->pops)
+		memcpy(npops, sim->pops, sim->islands * sizeof(size_t));
+
+	payoffs_reset(&pay, mutant, incumbent);
+	payoffs_share(sim, &pay, incumbentidx, mutantidx);
+
 	/*
-	 * Precompute all possible payoffs.
-	 * This allows us not to re-run the lambda calculation for each
-	 * individual.
-	 * If we have only a single island size, then avoid allocating
-	 * for each island by using only the first mcaches index.
+	 * With the exact engine, solve the chain (unless we just did for
+	 * the same strategies: it covers all starting islands) and
+	 * record its answer in place of a run.
+	 * If the solver didn't converge, its guess is no answer: sample
+	 * a run of this lattice point instead.
 	 */
-	if (NULL != sim->pops)
-		for (i = 0; i < sim->islands; i++) {
-			for (j = 0; j <= sim->pops[i]; j++) {
-				for (k = 0; k <= j; k++) {
-					mcaches[i][j][k] = reproduce
-						(sim, mutant, mutant, 
-						 incumbent, k, j);
-					icaches[i][j][k] = reproduce
-						(sim, incumbent, mutant, 
-						 incumbent, k, j);
-				}
+	if (NULL != ex) {
+		if ((0 == exvalid && 0 == exfailed) || 
+		    exmutant != mutant || exincumbent != incumbent) {
+			for (i = 0; i < sim->islands; i++) {
+				n = NULL != sim->pops ? 
+					sim->pops[i] : sim->pop;
+				for (k = 0; k <= n; k++)
+					(void)payoff_get(sim, &pay, n, k);
+				rows[i] = payoff_get(sim, &pay, n, 0);
 			}
+			exmutant = mutant;
+			exincumbent = incumbent;
+			exvalid = exact_solve(ex, sim, rows);
+			if ((exfailed = ! exvalid))
+				g_debug("%p: Exact solve didn't "
+					"converge: sampling", 
+					g_thread_self());
 		}
-	else
-		for (i = 0; i <= sim->pop; i++) {
-			mcache[i] = reproduce(sim, mutant,
-				mutant, incumbent, i, sim->pop);
-			icache[i] = reproduce(sim, incumbent,
-				mutant, incumbent, i, sim->pop);
+		if (exvalid) {
+			on_sim_solved(thr, islandidx, incumbentidx, 
+				exact_fixation(ex, islandidx), 
+				exact_time(ex, islandidx));
+			vp = NULL;
+			goto again;
+		}
+	}
+
+	/* 
+	 * Likewise for the diffusion engine, which doesn't depend on
+	 * the starting island at all.
+	 */
+	if (NULL != dif) {
+		if ( ! exvalid || exmutant != mutant || 
+		    exincumbent != incumbent) {
+			exfix = diffusion_solve(dif, sim, 
+				mutant, incumbent, &extime);
+			exmutant = mutant;
+			exincumbent = incumbent;
+			exvalid = 1;
 		}
+		on_sim_solved(thr, islandidx, 
+			incumbentidx, exfix, extime);
+		vp = NULL;
+		goto again;
+	}
+
+	if (NULL != fp)
+		frontier_scan(sim, fp, &pay, imutants);
+
+	/* Start every island's shot clock. */
+	if (NULL != ideaths) {
+		for (i = 0; i < sim->islands; i++) {
+			ideaths[i].gen = 1 + 
+				gsl_ran_poisson(rng, sim->ideathmean);
+			ideaths[i].island = i;
+			ideaths[i].dead = 0;
+		}
+		for (i = sim->islands / 2; i > 0; i--)
+			ideath_sift(ideaths, sim->islands, i - 1);
+	}
+
+	if (SIM_HIST(sim)) {
+		memset(hist, 0, (sim->pop + 1) * sizeof(size_t));
+		hist[0] = sim->islands - 1;
+		tag = 1;
+		t = hist_run(sim, rng, &pay, hist, moves, &tag, &mutants);
+		incumbents = sim->totalpop - mutants;
+		if (0 != mutants && 0 != incumbents)
+			hist_scatter(sim, rng, hist, 
+				tag, islandidx, imutants);
+		goto out;
+	}
 
 	for (t = 0; t < sim->stop; t++) {
-		if (NULL != sim->pops && sim->ideathmean > 0) {
-			/*
-			 * If we're a non-uniform population and have an
-			 * island death mean, then see if we're supposed
-			 * to kill off islands, then re-set the shot
-			 * clock.
-			 */
-			for (i = 0; i < sim->islands; i++) {
-				/* 
-				 * If the shot-clock has not been
-				 * started OR the island is already
-				 * dead, set it again.
-				 */
-				if (0 == ndeaths[i] || 0 == npops[i]) {
-					ndeaths[i] = t + 1 +
-						gsl_ran_poisson
-						(rng, sim->ideathmean);
-					continue;
-				} else if (t != ndeaths[i])
-					continue;
+		/*
+		 * If nothing can happen until an emigrant crosses over
+		 * to an island of the other type, skip the quiet
+		 * generations, whose number is geometric with success
+		 * probability 1 - exp(-rate), then run the one where
+		 * it happens (if it's before we stop).
+		 */
+		if (0 == SIM_IDEATH(sim) && 
+		    (NULL == fp || frontier_full(sim, fp, imutants)) &&
+		    quiet(sim, &pay, imutants, 
+		    npops, in, foreign, same, &rate)) {
+			skip = 0.0 == rate ? sim->stop :
+				floor(gsl_ran_exponential
+				 (rng, 1.0) / rate);
+			if (skip >= sim->stop - t) {
+				t = sim->stop;
+				break;
+			}
+			t += skip;
+			event(sim, rng, rate, foreign, same, npops, 
+				imutants, counts, &mutants, &incumbents);
+			if (0 == mutants || 0 == incumbents) 
+				break;
+			if (NULL != fp)
+				frontier_scan(sim, fp, &pay, imutants);
+			continue;
+		}
 
-				ndeaths[i] = t + 1 +
-					gsl_ran_poisson
-					(rng, sim->ideathmean);
-
-				/* 
-				 * What's the sum of our payoffs?
-				 * Compute the probability that we're
-				 * going to be killed from that and our
-				 * coefficient.
-				 */
-				g_assert(npops[i] > 0);
-				v = mcaches[i][npops[i]][imutants[i]] *
-					imutants[i] +
-				    icaches[i][npops[i]][imutants[i]] *
-				    	(npops[i] - imutants[i]);
-				prob = sim->ideathcoef * exp(-v);
-				if (gsl_rng_uniform(rng) >= prob)
-					continue;
+		/*
+		 * If mutants are only on a few islands, only simulate
+		 * those and the islands their emigrants reach.
+		 */
+		if (NULL != fp && 
+		    fp->len * SIM_FRONTIER_FRAC <= sim->islands) {
+			frontier_step(sim, rng, fp, &pay, imutants, 
+				kids, migrants, &mutants, &incumbents);
+			if (0 == mutants || 0 == incumbents) 
+				break;
+			continue;
+		}
+
+		/*
+		 * If we're a non-uniform population and have an island
+		 * death mean, see whose shot clocks have run out, then
+		 * re-set them.
+		 * The heap has each island's next check, soonest first,
+		 * so we only touch the islands due this generation.
+		 */
+		while (NULL != ideaths && ideaths[0].gen <= t) {
+			i = ideaths[0].island;
+			if (0 == npops[i]) {
+				/* Dead: wait until it's repopulated. */
+				ideaths[0].gen = t + 1;
+				ideaths[0].dead = 1;
+				ideath_sift(ideaths, sim->islands, 0);
+				continue;
+			} else if (ideaths[0].dead) {
+				/* Repopulated: start the shot clock. */
+				ideaths[0].gen = t + 
+					gsl_ran_poisson(rng, sim->ideathmean);
+				ideaths[0].dead = 0;
+				ideath_sift(ideaths, sim->islands, 0);
+				continue;
+			}
+
+			ideaths[0].gen = t + 1 +
+				gsl_ran_poisson(rng, sim->ideathmean);
+
+			/* 
+			 * What's the sum of our payoffs?
+			 * Compute the probability that we're going to
+			 * be killed from that and our coefficient.
+			 */
+			pp = payoff_get(sim, &pay, npops[i], imutants[i]);
+			v = pp->m * imutants[i] +
+			    pp->i * (npops[i] - imutants[i]);
+			prob = sim->ideathcoef * exp(-v);
+			if (gsl_rng_uniform(rng) < prob) {
 				mutants -= imutants[i];
 				incumbents -= (npops[i] - imutants[i]);
 				ntotalpop -= npops[i];
 				npops[i] = 0;
 				imutants[i] = 0;
+				ideaths[0].gen = t + 1;
+				ideaths[0].dead = 1;
 			}
+			ideath_sift(ideaths, sim->islands, 0);
 		}
 
 		/*
 		 * Birth process: have each individual (first mutants,
 		 * then incumbents) give birth.
-		 * Use a Poisson process with the given mean in order to
-		 * properly compute this.
-		 * We need two separate versions for whichever type of
-		 * mcache we decide to use.
+		 * Every mutant (resp. incumbent) on an island shares the
+		 * same Poisson mean, and the sum of independent Poisson
+		 * variates is itself Poisson with the summed mean, so we
+		 * draw each island's offspring pool in one go.
+		 * We need two separate versions for whether island
+		 * sizes are uniform.
 		 */
 		if (NULL != sim->pops)
 			for (j = 0; j < sim->islands; j++) {
@@ -577,19 +1875,20 @@ again:
 				g_assert(0 == migrants[0][j]);
 				g_assert(0 == migrants[1][j]);
 				g_assert(imutants[j] <= npops[j]);
-				lambda = mcaches[j]
-					[npops[j]][imutants[j]];
-				for (k = 0; k < imutants[j]; k++) {
-					offs = gsl_ran_poisson
-						(rng, lambda);
-					kids[0][j] += offs;
+				pp = payoff_get(sim, &pay, 
+					npops[j], imutants[j]);
+				if (imutants[j] > 0) {
+					lambda = pp->m;
+					kids[0][j] = poisson(rng, 
+						lambda * imutants[j],
+						pp->em);
 				}
-				lambda = icaches[j]
-					[npops[j]][imutants[j]];
-				for ( ; k < npops[j]; k++) {
-					offs = gsl_ran_poisson
-						(rng, lambda);
-					kids[1][j] += offs;
+				if (imutants[j] < npops[j]) {
+					lambda = pp->i;
+					kids[1][j] = poisson(rng, 
+						lambda *
+						(npops[j] - imutants[j]),
+						pp->ei);
 				}
 			}
 		else
@@ -598,59 +1897,40 @@ again:
 				g_assert(0 == kids[1][j]);
 				g_assert(0 == migrants[0][j]);
 				g_assert(0 == migrants[1][j]);
-				lambda = mcache[imutants[j]];
-				for (k = 0; k < imutants[j]; k++) {
-					offs = gsl_ran_poisson
-						(rng, lambda);
-					kids[0][j] += offs;
+				pp = payoff_get(sim, &pay, 
+					sim->pop, imutants[j]);
+				if (imutants[j] > 0) {
+					lambda = pp->m;
+					kids[0][j] = poisson(rng, 
+						lambda * imutants[j],
+						pp->em);
 				}
-				lambda = icache[imutants[j]];
-				for ( ; k < sim->pop; k++) {
-					offs = gsl_ran_poisson
-						(rng, lambda);
-					kids[1][j] += offs;
+				if (imutants[j] < sim->pop) {
+					lambda = pp->i;
+					kids[1][j] = poisson(rng, 
+						lambda *
+						(sim->pop - imutants[j]),
+						pp->ei);
 				}
 			}
 
 		/*
 		 * Determine whether we're going to migrate and, if
 		 * migration is stipulated, to where.
+		 * Each offspring leaves independently with probability
+		 * "m", so the number of emigrants is binomial; those who
+		 * stay join their own island's migrant queue.
 		 */
-		if (NULL != sim->ms)
-			for (j = 0; j < sim->islands; j++) {
-				for (k = 0; k < kids[0][j]; k++) {
-					new = j;
-					if (gsl_rng_uniform(rng) < sim->m)
-						new = migrate(sim, rng, j);
-					migrants[0][new]++;
-				}
-				for (k = 0; k < kids[1][j]; k++) {
-					new = j;
-					if (gsl_rng_uniform(rng) < sim->m)
-						new = migrate(sim, rng, j);
-					migrants[1][new]++;
-				}
-				kids[0][j] = kids[1][j] = 0;
-			}
-		else
-			for (j = 0; j < sim->islands; j++) {
-				for (k = 0; k < kids[0][j]; k++) {
-					new = j;
-					if (gsl_rng_uniform(rng) < sim->m) do 
-						new = gsl_rng_uniform_int
-							(rng, sim->islands);
-					while (new == j);
-					migrants[0][new]++;
-				}
-				for (k = 0; k < kids[1][j]; k++) {
-					new = j;
-					if (gsl_rng_uniform(rng) < sim->m) do 
-						new = gsl_rng_uniform_int
-							(rng, sim->islands);
-					while (new == j);
-					migrants[1][new]++;
-				}
-				kids[0][j] = kids[1][j] = 0;
+		for (j = 0; j < sim->islands; j++)
+			for (k = 0; k < 2; k++) {
+				if (0 == kids[k][j])
+					continue;
+				len1 = gsl_ran_binomial(rng, 
+					sim->m, kids[k][j]);
+				migrants[k][j] += kids[k][j] - len1;
+				migrate(sim, rng, j, len1, 
+					migrants[k], counts, probs);
+				kids[k][j] = 0;
 			}
 
 		/*
@@ -733,11 +2013,15 @@ again:
 				migrants[0][j] = migrants[1][j] = 0;
 			}
 
+		if (NULL != fp)
+			frontier_scan(sim, fp, &pay, imutants);
+
 		/* Stop when a population goes extinct. */
 		if (0 == mutants || 0 == incumbents) 
 			break;
 	}
 
+out:
 	/*
 	 * Assign the result pointer to the last population fraction.
 	 * This will be processed by on_sim_next().
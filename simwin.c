@@ -17,6 +17,9 @@
 #include <assert.h>
 #include <stdint.h>
 #include <stdlib.h>
+#ifdef __linux__
+#include <bsd/stdlib.h> /* arc4random() */
+#endif
 #include <string.h>
 
 #ifdef MAC_INTEGRATION
@@ -25,6 +28,7 @@
 #include <gtk/gtk.h>
 #include <gdk/gdk.h>
 #include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
 #include <gsl/gsl_multifit.h>
 #include <gsl/gsl_histogram.h>
 #include <kplot.h>
@@ -317,6 +321,13 @@ window_add_sim(struct curwin *cur, struct sim *sim)
 		abort();
 	}
 
+	if (ENGINE_EXACT == sim->engine)
+		window_add_config(box, "Engine: exact");
+	else if (ENGINE_DIFFUSION == sim->engine)
+		window_add_config(box, "Engine: diffusion");
+	if (NULL != sim->sched)
+		window_add_config(box, "Incumbent sampling: adaptive");
+
 	if (0 == sim->fitpoly) 
 		window_add_config(box, "Polynomial fitting: disabled");
 	else
@@ -768,6 +779,26 @@ on_rangefind_idle(gpointer dat)
 	return(rangefind(dat));
 }
 
+/*
+ * Compile "exp" with the number of players bound to "n" (unless zero),
+ * natively if "native" is set and we can.
+ */
+static struct hprog *
+exp2prog(struct hnode **exp, size_t n, int native)
+{
+	struct hnode	**bound;
+	struct hprog	 *p;
+
+	bound = 0 == n ? exp : hnode_bind
+		((const struct hnode *const *)exp, n);
+	p = hprog_compile((const struct hnode *const *)bound);
+	if (native)
+		hprog_native(p, (const struct hnode *const *)bound);
+	if (bound != exp)
+		hnode_free(bound);
+	return(p);
+}
+
 static int
 entry2func(GtkEntry *entry, struct hnode ***exp, GtkLabel *error)
 {
@@ -996,10 +1027,11 @@ onactivate(GtkButton *button, gpointer dat)
 	GtkLabel	 *err = b->wins.error;
 	const gchar	 *name, *func;
 	gchar	  	 *file;
-	gdouble		**ms;
+	struct mkernel	 *ms;
 	gdouble		  xmin, xmax, delta, alpha, m, sigma,
 			  ymin, ymax, idcoef, strat;
 	enum mutants	  mutants;
+	enum engine	  engine;
 	size_t		  i, totalpop, islands, stop, ideathmean,
 			  slices, islandpop, mapindexfix;
 	size_t		 *islandpops;
@@ -1226,6 +1258,32 @@ onactivate(GtkButton *button, gpointer dat)
 	} else if (NULL == islandpops)
 		totalpop = islands * islandpop;
 
+	for (engine = 0; engine < ENGINE__MAX; engine++)
+		if (gtk_toggle_button_get_active(b->wins.engines[engine]))
+			break;
+
+	/* 
+	 * The exact engine needs a small chain without island death;
+	 * the diffusion engine, uniform islands.
+	 */
+	if (ENGINE_EXACT == engine && ideathmean > 0) {
+		gtk_label_set_text(err, "Error: the exact engine "
+			"doesn't model island death.");
+		gtk_widget_show_all(GTK_WIDGET(err));
+		goto cleanup;
+	} else if (ENGINE_EXACT == engine && ! exact_feasible
+		   (islands, islandpop, islandpops)) {
+		gtk_label_set_text(err, "Error: too many islanders "
+			"for the exact engine.");
+		gtk_widget_show_all(GTK_WIDGET(err));
+		goto cleanup;
+	} else if (ENGINE_DIFFUSION == engine && NULL != islandpops) {
+		gtk_label_set_text(err, "Error: the diffusion engine "
+			"needs uniform island populations.");
+		gtk_widget_show_all(GTK_WIDGET(err));
+		goto cleanup;
+	}
+
 	for (mutants = 0; mutants < MUTANTS__MAX; mutants++)
 		if (gtk_toggle_button_get_active
 			(GTK_TOGGLE_BUTTON(b->wins.mutants[mutants])))
@@ -1297,6 +1355,8 @@ onactivate(GtkButton *button, gpointer dat)
 			b->range.n = islandpop;
 
 		b->range.exp = exp;
+		hprog_free(b->range.prog);
+		b->range.prog = exp2prog(exp, b->range.n, b->native);
 		b->range.alpha = alpha;
 		b->range.delta = delta;
 		b->range.slices = slices;
@@ -1336,7 +1396,17 @@ onactivate(GtkButton *button, gpointer dat)
 	sim->dims = slices;
 	sim->islands = islands;
 	sim->mutants = mutants;
+	sim->engine = engine;
+	if (gtk_toggle_button_get_active(b->wins.adaptive)) {
+		sim->schedsz = slices * SIM_SCHED_SLOTS;
+		sim->sched = g_malloc_n(sim->schedsz, sizeof(gint));
+		for (i = 0; i < sim->schedsz; i++)
+			sim->sched[i] = i % slices;
+	}
 	sim->mutantsigma = sigma;
+	if (MUTANTS_DISCRETE == mutants)
+		sim->ptabs = g_malloc0_n
+			(slices * slices, sizeof(struct payoff *));
 	sim->func = g_strdup(func);
 	sim->name = g_strdup(name);
 	sim->fitpoly = gtk_adjustment_get_value(b->wins.fitpoly);
@@ -1355,17 +1425,6 @@ onactivate(GtkButton *button, gpointer dat)
 	g_mutex_init(&sim->hot.mux);
 	g_cond_init(&sim->hot.cond);
 
-	/* Source for the fraction of mutants. */
-	sim->bufs.fractions = kdata_array_alloc(NULL, slices);
-	g_assert(NULL != sim->bufs.fractions);
-	sim->bufs.ifractions = kdata_array_alloc(NULL, islands);
-	g_assert(NULL != sim->bufs.ifractions);
-	sim->bufs.mutants = kdata_array_alloc(NULL, slices);
-	g_assert(NULL != sim->bufs.mutants);
-	sim->bufs.incumbents = kdata_array_alloc(NULL, slices);
-	g_assert(NULL != sim->bufs.incumbents);
-	sim->bufs.islands = kdata_array_alloc(NULL, islands);
-	g_assert(NULL != sim->bufs.islands);
 	sim->bufs.meanmins = kdata_array_alloc(NULL, slices);
 	g_assert(NULL != sim->bufs.meanmins);
 	sim->bufs.mextinctmaxs = kdata_array_alloc(NULL, slices);
@@ -1385,9 +1444,6 @@ onactivate(GtkButton *button, gpointer dat)
 
 	for (i = 0; i < slices; i++) {
 		strat = xmin + (xmax - xmin) * (i / (double)slices);
-		kdata_array_set(sim->bufs.fractions, i, strat, 0);
-		kdata_array_set(sim->bufs.mutants, i, strat, 0);
-		kdata_array_set(sim->bufs.incumbents, i, strat, 0);
 		kdata_array_set(sim->bufs.meanmins, i, strat, 0);
 		kdata_array_set(sim->bufs.mextinctmaxs, i, strat, 0);
 		kdata_array_set(sim->bufs.iextinctmins, i, strat, 0);
@@ -1395,24 +1451,20 @@ onactivate(GtkButton *button, gpointer dat)
 		kdata_array_set(sim->bufs.fitpolymins, i, strat, 0);
 	}
 
-	sim->bufs.times = simbuf_alloc
-		(kdata_array_alloc(NULL, stop + 1), stop + 1);
-	sim->bufs.islandmeans = simbuf_alloc
-		(kdata_mean_alloc(sim->bufs.islands), islands);
-	sim->bufs.islandstddevs = simbuf_alloc
-		(kdata_stddev_alloc(sim->bufs.islands), islands);
-	sim->bufs.imeans = simbuf_alloc
-		(kdata_mean_alloc(sim->bufs.ifractions), islands);
-	sim->bufs.istddevs = simbuf_alloc
-		(kdata_stddev_alloc(sim->bufs.ifractions), islands);
-	sim->bufs.means = simbuf_alloc
-		(kdata_mean_alloc(sim->bufs.fractions), slices);
-	sim->bufs.stddevs = simbuf_alloc
-		(kdata_stddev_alloc(sim->bufs.fractions), slices);
-	sim->bufs.mextinct = simbuf_alloc
-		(kdata_mean_alloc(sim->bufs.mutants), slices);
-	sim->bufs.iextinct = simbuf_alloc
-		(kdata_mean_alloc(sim->bufs.incumbents), slices);
+	/*
+	 * These are computed from the raw results accumulated by each
+	 * thread (see "struct simacc") when copying out.
+	 */
+	sim->bufs.times = simbuf_alloc(stop + 1);
+	sim->bufs.islandmeans = simbuf_alloc(islands);
+	sim->bufs.islandstddevs = simbuf_alloc(islands);
+	sim->bufs.imeans = simbuf_alloc(islands);
+	sim->bufs.istddevs = simbuf_alloc(islands);
+	sim->bufs.means = simbuf_alloc(slices);
+	sim->bufs.stddevs = simbuf_alloc(slices);
+	sim->bufs.mextinct = simbuf_alloc(slices);
+	sim->bufs.iextinct = simbuf_alloc(slices);
+	simacc_init(&sim->acc, slices, islands, stop);
 
 	/*
 	 * Conditionally allocate our fitness polynomial structures.
@@ -1434,6 +1486,8 @@ onactivate(GtkButton *button, gpointer dat)
 	}
 
 	sim->nprocs = gtk_adjustment_get_value(b->wins.nthreads);
+	sim->seed = b->seeded ? b->seed :
+		(uint64_t)arc4random() << 32 | arc4random();
 	sim->totalpop = totalpop;
 	sim->stop = stop;
 	sim->alpha = alpha;
@@ -1445,10 +1499,39 @@ onactivate(GtkButton *button, gpointer dat)
 	sim->pops = islandpops;
 	sim->input = input;
 	sim->exp = exp;
+	sim->prog = exp2prog(exp, 0, b->native);
+
+	/*
+	 * Unless we have native code, also compile the function bound
+	 * to the size of each island.
+	 * Sizes not found here (islands dying) use the unbound one.
+	 */
+	if (NULL == sim->prog->fn) {
+		if (NULL == islandpops)
+			sim->progsz = islandpop + 1;
+		else
+			for (i = 0; i < islands; i++)
+				if (islandpops[i] + 1 > sim->progsz)
+					sim->progsz = islandpops[i] + 1;
+		sim->progs = g_malloc0_n
+			(sim->progsz, sizeof(struct hprog *));
+		if (NULL == islandpops)
+			sim->progs[islandpop] = 
+				exp2prog(exp, islandpop, 0);
+		else
+			for (i = 0; i < islands; i++)
+				if (NULL == sim->progs[islandpops[i]])
+					sim->progs[islandpops[i]] = exp2prog
+						(exp, islandpops[i], 0);
+	}
 	sim->xmin = xmin;
 	sim->xmax = xmax;
 	sim->ymin = ymin;
 	sim->ymax = ymax;
+
+	if (NULL != sim->ms)
+		mkernel_prep(sim->ms);
+
 	b->sims = g_list_append(b->sims, sim);
 	sim_ref(sim, NULL);
 	sim->threads = g_malloc0_n(sim->nprocs, sizeof(struct simthr));
@@ -1458,6 +1541,8 @@ onactivate(GtkButton *button, gpointer dat)
 	for (i = 0; i < sim->nprocs; i++) {
 		sim->threads[i].rank = i;
 		sim->threads[i].sim = sim;
+		simacc_init(&sim->threads[i].acc, 
+			slices, islands, stop);
 		sim->threads[i].thread = g_thread_new
 			(NULL, simulation, &sim->threads[i]);
 	}
@@ -1471,11 +1556,8 @@ onactivate(GtkButton *button, gpointer dat)
 	donamefill(&b->wins);
 	return;
 cleanup:
-	if (NULL != ms)
-		for (i = 0; i < islands; i++)
-			g_free(ms[i]);
 	g_free(islandpops);
-	g_free(ms);
+	mkernel_free(ms);
 	hnode_free(exp);
 	kml_free(kml);
 }